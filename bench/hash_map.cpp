@@ -0,0 +1,168 @@
+// Measures the cost of the tracer state lookups done by the probes with
+// std::unordered_map and with FlatHashMap.
+//
+// usage: make benchmark-hash-map
+//        bench/hash_map [probe_count]
+//
+// Each simulated probe does the table operations of a promise's life in the
+// tracer: the promise is created (promise_ids, fresh_promises), passed to a
+// call (functions, environments, fresh_promises, promise_origin), looked up
+// a few times (promise_ids, promise_origin) and unmarked by the GC
+// (promise_ids, promise_origin). Keys are addresses of 56 byte cells spread
+// over a heap, like SEXPs, and sequential promise ids. The cost is reported
+// in nanoseconds per table operation.
+
+#include "../src/FlatHashMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const std::size_t CELL_SIZE = 56;
+const std::size_t HEAP_CELL_COUNT = 1 << 20;
+const std::size_t FUNCTION_COUNT = 4096;
+const std::size_t ENVIRONMENT_COUNT = 65536;
+const std::size_t LIVE_PROMISE_COUNT = 100000;
+const std::size_t LOOKUPS_PER_PROMISE = 4;
+const std::size_t OPERATIONS_PER_PROBE = 9 + 2 * LOOKUPS_PER_PROMISE;
+
+typedef void *sexp_t;
+typedef std::int64_t prom_id_t;
+typedef std::uint64_t call_id_t;
+
+struct function_t {
+    std::uint64_t fn_id;
+    std::string definition;
+};
+
+template <typename Map, typename Set, typename FunctionMap,
+          typename EnvironmentMap>
+struct tables_t {
+    Map promise_ids;
+    Map promise_origin;
+    Set fresh_promises;
+    FunctionMap functions;
+    EnvironmentMap environments;
+};
+
+typedef tables_t<std::unordered_map<std::uintptr_t, prom_id_t>,
+                 std::unordered_set<prom_id_t>,
+                 std::unordered_map<sexp_t, function_t>,
+                 std::unordered_map<sexp_t, int>>
+    std_tables_t;
+
+typedef tables_t<FlatHashMap<std::uintptr_t, prom_id_t>,
+                 FlatHashSet<prom_id_t>, FlatHashMap<sexp_t, function_t>,
+                 FlatHashMap<sexp_t, int>>
+    flat_tables_t;
+
+template <typename Tables>
+double run(const std::vector<char> &heap, const std::vector<std::size_t> &cells,
+           std::size_t probe_count, std::uint64_t &checksum) {
+    Tables tables;
+    const char *base = heap.data();
+
+    for (std::size_t index = 0; index < FUNCTION_COUNT; ++index) {
+        sexp_t function = (sexp_t)(base + cells[index] * CELL_SIZE);
+        tables.functions[function] = function_t{index, "function() NULL"};
+    }
+    for (std::size_t index = 0; index < ENVIRONMENT_COUNT; ++index) {
+        sexp_t rho = (sexp_t)(base + cells[FUNCTION_COUNT + index] * CELL_SIZE);
+        tables.environments[rho] = (int)index;
+    }
+
+    std::mt19937_64 random(42);
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t probe = 0; probe < probe_count; ++probe) {
+        prom_id_t prom_id = (prom_id_t)probe;
+        std::uintptr_t address =
+            (std::uintptr_t)(base + cells[probe % cells.size()] * CELL_SIZE);
+        std::uint64_t draw = random();
+
+        /* promise created */
+        tables.promise_ids[address] = prom_id;
+        tables.fresh_promises.insert(prom_id);
+
+        /* promise passed to a call */
+        sexp_t function =
+            (sexp_t)(base + cells[draw % FUNCTION_COUNT] * CELL_SIZE);
+        checksum += tables.functions.find(function)->second.fn_id;
+        sexp_t rho = (sexp_t)(base +
+                              cells[FUNCTION_COUNT +
+                                    (draw >> 16) % ENVIRONMENT_COUNT] *
+                                  CELL_SIZE);
+        checksum += tables.environments.find(rho)->second;
+        if (tables.fresh_promises.erase(prom_id)) {
+            tables.promise_origin[prom_id] = (call_id_t)probe;
+        }
+
+        /* promise looked up */
+        for (std::size_t lookup = 0; lookup < LOOKUPS_PER_PROMISE; ++lookup) {
+            checksum += tables.promise_ids.find(address)->second;
+            checksum += tables.promise_origin.find(prom_id)->second;
+        }
+
+        /* an older promise unmarked by the gc */
+        if (probe >= LIVE_PROMISE_COUNT) {
+            std::size_t old = probe - LIVE_PROMISE_COUNT;
+            std::uintptr_t old_address =
+                (std::uintptr_t)(base + cells[old % cells.size()] * CELL_SIZE);
+            auto iter = tables.promise_ids.find(old_address);
+            if (iter != tables.promise_ids.end()) {
+                checksum += tables.promise_origin.erase(iter->second);
+                tables.promise_ids.erase(iter);
+            }
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double nanoseconds =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    return nanoseconds / (probe_count * OPERATIONS_PER_PROBE);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t probe_count = argc >= 2 ? std::strtoull(argv[1], nullptr, 10)
+                                        : 10000000;
+
+    /* cells are handed out in a shuffled order, as by a heap that has been
+       through a few collections */
+    std::vector<char> heap(HEAP_CELL_COUNT * CELL_SIZE);
+    std::vector<std::size_t> cells(HEAP_CELL_COUNT);
+    for (std::size_t index = 0; index < HEAP_CELL_COUNT; ++index) {
+        cells[index] = index;
+    }
+    std::shuffle(cells.begin(), cells.end(), std::mt19937_64(7));
+
+    std::uint64_t std_checksum = 0;
+    std::uint64_t flat_checksum = 0;
+    double std_cost = run<std_tables_t>(heap, cells, probe_count, std_checksum);
+    double flat_cost =
+        run<flat_tables_t>(heap, cells, probe_count, flat_checksum);
+
+    if (std_checksum != flat_checksum) {
+        std::fprintf(stderr, "checksum mismatch: %llu != %llu\n",
+                     (unsigned long long)std_checksum,
+                     (unsigned long long)flat_checksum);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("table\tns_per_operation\n");
+    std::printf("unordered_map\t%.2f\n", std_cost);
+    std::printf("flat_hash_map\t%.2f\n", flat_cost);
+    std::printf("speedup\t%.2f\n", std_cost / flat_cost);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#ifndef PROMISEDYNTRACER_ANALYSIS_H
+#define PROMISEDYNTRACER_ANALYSIS_H
+
+#include "State.h"
+
+/* Base of the analyses run by StaticAnalysisDriver. It has an empty handler
+   for every event so that analyses only define the ones they care about.
+   Handlers are resolved at compile time against the concrete analysis type,
+   so none of them are virtual and the empty ones compile away. Analyses that
+   read optional call info fields shadow CALL_INFO_FIELDS, those that handle
+   events of optional probes shadow PROBE_GROUPS. */
+class Analysis {
+  public:
+    static constexpr call_info_fields_t CALL_INFO_FIELDS = 0;
+    static constexpr probe_groups_t PROBE_GROUPS = 0;
+    /* whether the analysis only sees the events of sampled calls */
+    static constexpr bool SAMPLED = true;
+
+    void closure_entry(const closure_info_t &closure_info) {}
+    void closure_exit(const closure_info_t &closure_info) {}
+    void special_entry(const builtin_info_t &special_info) {}
+    void special_exit(const builtin_info_t &special_info) {}
+    void builtin_entry(const builtin_info_t &builtin_info) {}
+    void builtin_exit(const builtin_info_t &builtin_info) {}
+
+    void promise_created(const prom_basic_info_t &prom_basic_info,
+                         const SEXP promise) {}
+    void promise_force_entry(const prom_info_t &prom_info, const SEXP promise) {
+    }
+    void promise_force_exit(const prom_info_t &prom_info, const SEXP promise) {}
+    void promise_environment_lookup(const prom_info_t &info,
+                                    const SEXP promise) {}
+    void promise_expression_lookup(const prom_info_t &info,
+                                   const SEXP promise) {}
+    void promise_value_lookup(const prom_info_t &info, const SEXP promise) {}
+    void promise_environment_set(const prom_info_t &info, const SEXP promise) {
+    }
+    void promise_expression_set(const prom_info_t &info, const SEXP promise) {}
+    void promise_value_set(const prom_info_t &info, const SEXP promise) {}
+
+    void gc_promise_unmarked(const prom_id_t prom_id, const SEXP promise) {}
+    void vector_alloc(const type_gc_info_t &type_gc_info) {}
+    void environment_define_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) {}
+    void environment_assign_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) {}
+    void environment_lookup_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) {}
+    void environment_remove_var(const SEXP symbol, const SEXP rho) {}
+    void context_jump(const unwind_info_t &info) {}
+    void end(dyntracer_t *dyntracer) {}
+};
+
+#endif /* PROMISEDYNTRACER_ANALYSIS_H */
@@ -6,67 +6,135 @@
 #include "ObjectCountSizeAnalysis.h"
 #include "PromiseEvaluationAnalysis.h"
 #include "PromiseTypeAnalysis.h"
+#include "Sampler.h"
 #include "SideEffectAnalysis.h"
 #include "State.h"
 #include "StrictnessAnalysis.h"
+#include <memory>
 
+/* Interface between the probes and the analyses. The set of analyses is
+   fixed at compile time by StaticAnalysisDriver, create picks the
+   instantiation matching the analysis switch. */
 class AnalysisDriver {
 
   public:
-    AnalysisDriver(tracer_state_t &tracer_state, bool verbose,
+    static AnalysisDriver *create(tracer_state_t &tracer_state,
+                                  const Sampler &sampler, bool verbose,
+                                  const std::string &output_dir,
+                                  bool truncate, bool binary,
+                                  int compression_level,
+                                  int compression_threads,
+                                  const AnalysisSwitch analysis_switch);
+
+    virtual ~AnalysisDriver() {}
+
+    /* fields of call_info_t read by the enabled analyses */
+    virtual call_info_fields_t get_call_info_fields() const = 0;
+
+    /* optional probes whose events the enabled analyses handle */
+    virtual probe_groups_t get_probe_groups() const = 0;
+
+    void begin(dyntracer_t *dyntracer) {}
+    virtual void closure_entry(const closure_info_t &closure_info) = 0;
+    virtual void closure_exit(const closure_info_t &closure_info) = 0;
+    virtual void special_entry(const builtin_info_t &special_info) = 0;
+    virtual void special_exit(const builtin_info_t &special_info) = 0;
+    virtual void builtin_entry(const builtin_info_t &builtin_info) = 0;
+    virtual void builtin_exit(const builtin_info_t &builtin_info) = 0;
+
+    virtual void promise_created(const prom_basic_info_t &prom_basic_info,
+                                 const SEXP promise) = 0;
+    virtual void promise_force_entry(const prom_info_t &prom_info,
+                                     const SEXP promise) = 0;
+    virtual void promise_force_exit(const prom_info_t &prom_info,
+                                    const SEXP promise) = 0;
+    virtual void promise_environment_lookup(const prom_info_t &info,
+                                            const SEXP promise) = 0;
+    virtual void promise_expression_lookup(const prom_info_t &info,
+                                           const SEXP promise) = 0;
+    virtual void promise_value_lookup(const prom_info_t &info,
+                                      const SEXP promise) = 0;
+    virtual void promise_environment_set(const prom_info_t &info,
+                                         const SEXP promise) = 0;
+    virtual void promise_expression_set(const prom_info_t &info,
+                                        const SEXP promise) = 0;
+    virtual void promise_value_set(const prom_info_t &info,
+                                   const SEXP promise) = 0;
+
+    virtual void gc_promise_unmarked(const prom_id_t prom_id,
+                                     const SEXP promise) = 0;
+    virtual void vector_alloc(const type_gc_info_t &type_gc_info) = 0;
+    virtual void environment_define_var(const SEXP symbol, const SEXP value,
+                                        const SEXP rho) = 0;
+    virtual void environment_assign_var(const SEXP symbol, const SEXP value,
+                                        const SEXP rho) = 0;
+    virtual void environment_lookup_var(const SEXP symbol, const SEXP value,
+                                        const SEXP rho) = 0;
+    virtual void environment_remove_var(const SEXP symbol,
+                                        const SEXP rho) = 0;
+    virtual void context_jump(const unwind_info_t &info) = 0;
+    virtual void end(dyntracer_t *dyntracer) = 0;
+
+  protected:
+    AnalysisDriver(tracer_state_t &tracer_state, const Sampler &sampler,
                    const std::string &output_dir, bool truncate, bool binary,
-                   int compression_level, const AnalysisSwitch analysis_switch);
-
-    void begin(dyntracer_t *dyntracer);
-    void closure_entry(const closure_info_t &closure_info);
-    void closure_exit(const closure_info_t &closure_info);
-    void special_entry(const builtin_info_t &special_info);
-    void special_exit(const builtin_info_t &special_info);
-    void builtin_entry(const builtin_info_t &builtin_info);
-    void builtin_exit(const builtin_info_t &builtin_info);
-
-    void promise_created(const prom_basic_info_t &prom_basic_info,
-                         const SEXP promise);
-    void promise_force_entry(const prom_info_t &prom_info, const SEXP promise);
-    void promise_force_exit(const prom_info_t &prom_info, const SEXP promise);
-    void promise_environment_lookup(const prom_info_t &info,
-                                    const SEXP promise);
-    void promise_expression_lookup(const prom_info_t &info, const SEXP promise);
-    void promise_value_lookup(const prom_info_t &info, const SEXP promise);
-    void promise_environment_set(const prom_info_t &info, const SEXP promise);
-    void promise_expression_set(const prom_info_t &info, const SEXP promise);
-    void promise_value_set(const prom_info_t &info, const SEXP promise);
-
-    void gc_promise_unmarked(const prom_id_t prom_id, const SEXP promise);
-    void vector_alloc(const type_gc_info_t &type_gc_info);
-    void environment_define_var(const SEXP symbol, const SEXP value,
-                                const SEXP rho);
-    void environment_assign_var(const SEXP symbol, const SEXP value,
-                                const SEXP rho);
-    void environment_lookup_var(const SEXP symbol, const SEXP value,
-                                const SEXP rho);
-    void environment_remove_var(const SEXP symbol, const SEXP rho);
-    void context_jump(const unwind_info_t &info);
-    void end(dyntracer_t *dyntracer);
-
-    inline bool analyze_metadata() const;
-    inline bool analyze_object_count_size() const;
-    inline bool analyze_promise_types() const;
-    inline bool analyze_promise_slot_mutations() const;
-    inline bool analyze_promise_evaluations() const;
-    inline bool analyze_functions() const;
-    inline bool analyze_strictness() const;
-    inline bool analyze_side_effects() const;
-    inline bool map_promises() const;
+                   int compression_level, int compression_threads,
+                   const AnalysisSwitch analysis_switch)
+        : tracer_state_{tracer_state}, sampler_{sampler},
+          output_dir_{output_dir},
+          truncate_{truncate}, binary_{binary},
+          compression_level_{compression_level},
+          compression_threads_{compression_threads},
+          analysis_switch_{analysis_switch}, promise_mapper_{nullptr} {}
+
+    /* Construct the analysis, unless runtime_switch is set and the analysis
+       switch turns it off. */
+    void create_(std::unique_ptr<PromiseMapper> &analysis,
+                 bool runtime_switch);
+    void create_(std::unique_ptr<ObjectCountSizeAnalysis> &analysis,
+                 bool runtime_switch);
+    void create_(std::unique_ptr<PromiseTypeAnalysis> &analysis,
+                 bool runtime_switch);
+    void create_(std::unique_ptr<PromiseEvaluationAnalysis> &analysis,
+                 bool runtime_switch);
+    void create_(std::unique_ptr<StrictnessAnalysis> &analysis,
+                 bool runtime_switch);
+    void create_(std::unique_ptr<SideEffectAnalysis> &analysis,
+                 bool runtime_switch);
+
+    bool analyze_object_count_size() const {
+        return analysis_switch_.object_count_size;
+    }
+
+    bool analyze_promise_types() const { return analysis_switch_.promise_type; }
+
+    bool analyze_promise_evaluations() const {
+        return analysis_switch_.promise_evaluation;
+    }
+
+    bool analyze_strictness() const { return analysis_switch_.strictness; }
+
+    bool analyze_side_effects() const { return analysis_switch_.side_effect; }
+
+    bool is_sampled() const { return sampler_.is_sampled(); }
+
+    bool map_promises() const {
+        return analysis_switch_.strictness ||
+               analysis_switch_.promise_evaluation ||
+               analysis_switch_.promise_slot_mutation;
+    }
 
   private:
-    AnalysisSwitch analysis_switch_;
-    PromiseMapper promise_mapper_;
-    ObjectCountSizeAnalysis object_count_size_analysis_;
-    PromiseEvaluationAnalysis promise_evaluation_analysis_;
-    PromiseTypeAnalysis promise_type_analysis_;
-    StrictnessAnalysis strictness_analysis_;
-    SideEffectAnalysis side_effect_analysis_;
+    tracer_state_t &tracer_state_;
+    const Sampler &sampler_;
+    const std::string output_dir_;
+    const bool truncate_;
+    const bool binary_;
+    const int compression_level_;
+    const int compression_threads_;
+    const AnalysisSwitch analysis_switch_;
+    /* shared with the analyses that look up promises in the mapper */
+    PromiseMapper *promise_mapper_;
 };
 
 #endif /* PROMISEDYNTRACER_ANALYSIS_DRIVER_H */
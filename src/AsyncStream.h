@@ -0,0 +1,159 @@
+#ifndef PROMISEDYNTRACER_ASYNC_STREAM_H
+#define PROMISEDYNTRACER_ASYNC_STREAM_H
+
+#include "Stream.h"
+#include "utilities.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* AsyncStream moves everything below it in the stream chain (compression,
+   buffering and file writes) to a dedicated writer thread. Writes are copied
+   into fixed size blocks which are handed over to the writer thread through
+   a single producer single consumer ring. Blocks are allocated on first use,
+   so a stream that sees little data holds one block. The writer thread
+   sleeps on a condition variable while the ring is empty and the producer
+   only sleeps when all blocks are in flight. flush waits until the writer
+   thread has drained the ring, after which the rest of the chain can be
+   used directly by the producer until the next write. */
+class AsyncStream : public Stream {
+  public:
+    explicit AsyncStream(Stream *sink,
+                         std::size_t block_capacity = 1024 * 1024,
+                         std::size_t block_count = 8)
+        : Stream(sink), block_capacity_{block_capacity},
+          blocks_{block_count, block_t{nullptr, 0}}, head_{0}, tail_{0},
+          stop_{false} {
+        writer_ = std::thread(&AsyncStream::drain_, this);
+    }
+
+    void write(const void *buffer, std::size_t bytes) override {
+        const char *buf = static_cast<const char *>(buffer);
+        std::size_t copied_bytes = 0;
+        while (bytes != 0) {
+            block_t &block = get_current_block_();
+            copied_bytes = std::min(block_capacity_ - block.size, bytes);
+            std::memcpy(block.data + block.size, buf, copied_bytes);
+            block.size += copied_bytes;
+            buf += copied_bytes;
+            bytes -= copied_bytes;
+            if (block.size == block_capacity_) {
+                publish_();
+            }
+        }
+    }
+
+    void flush() override {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (blocks_[head % blocks_.size()].size != 0) {
+            publish_();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        written_.wait(lock, [this] {
+            return tail_.load(std::memory_order_acquire) ==
+                   head_.load(std::memory_order_relaxed);
+        });
+    }
+
+    /* true until the first write, the streams below can be written to
+       directly until then */
+    bool is_unused() const {
+        return head_.load(std::memory_order_relaxed) == 0 &&
+               blocks_[0].size == 0;
+    }
+
+    virtual ~AsyncStream() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        published_.notify_one();
+        writer_.join();
+        for (block_t &block : blocks_) {
+            std::free(block.data);
+        }
+    }
+
+  private:
+    struct block_t {
+        char *data;
+        std::size_t size;
+    };
+
+    /* The producer owns the block at head_ as long as it is not in flight.
+       tail_ is only advanced by the writer thread after the block has been
+       written out, so waiting for it to move frees up a slot. */
+    block_t &get_current_block_() {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == blocks_.size()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            written_.wait(lock, [this, head] {
+                return head - tail_.load(std::memory_order_acquire) !=
+                       blocks_.size();
+            });
+        }
+        block_t &block = blocks_[head % blocks_.size()];
+        if (block.data == nullptr) {
+            block.data = static_cast<char *>(malloc_or_die(block_capacity_));
+        }
+        return block;
+    }
+
+    /* head_ is advanced under the mutex so that the writer thread cannot
+       miss the notification between checking the ring and sleeping */
+    void publish_() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            head_.store(head_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+        }
+        published_.notify_one();
+    }
+
+    void drain_() {
+        while (true) {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                published_.wait(lock, [this, tail] {
+                    return stop_ ||
+                           tail != head_.load(std::memory_order_acquire);
+                });
+                /* stop_ is only set after the final flush, so an empty ring
+                   at this point means everything has been written. */
+                if (tail == head_.load(std::memory_order_acquire)) {
+                    return;
+                }
+            }
+            block_t &block = blocks_[tail % blocks_.size()];
+            get_sink()->write(block.data, block.size);
+            block.size = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tail_.store(tail + 1, std::memory_order_release);
+            }
+            written_.notify_one();
+        }
+    }
+
+    const std::size_t block_capacity_;
+    std::vector<block_t> blocks_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+    std::mutex mutex_;
+    /* signalled when a block is published and when stop_ is set */
+    std::condition_variable published_;
+    /* signalled when a block has been written out */
+    std::condition_variable written_;
+    bool stop_;
+    std::thread writer_;
+};
+
+#endif /* PROMISEDYNTRACER_ASYNC_STREAM_H */
@@ -0,0 +1,15 @@
+#include "BinaryDataTableStream.h"
+
+const std::size_t BinaryDataTableStream::BLOCK_ROW_COUNT = 64 * 1024;
+
+const std::size_t BinaryDataTableStream::DICTIONARY_SIZE_LIMIT = 256 * 1024;
+
+const std::uint8_t BinaryDataTableStream::STRING_ENCODING_PLAIN = 0;
+
+const std::uint8_t BinaryDataTableStream::STRING_ENCODING_DICTIONARY = 1;
+
+const std::string BinaryDataTableStream::MAGIC = "PDTT";
+
+/* 1 is the columnar block layout, tables of the earlier row layout have no
+   magic */
+const std::uint32_t BinaryDataTableStream::FORMAT_VERSION = 1;
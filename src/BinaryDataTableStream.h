@@ -2,17 +2,48 @@
 #define PROMISEDYNTRACER_BINARY_DATA_TABLE_STREAM_H
 
 #include "DataTableStream.h"
+#include <unordered_map>
 
+/* The table starts with a header of MAGIC, FORMAT_VERSION, the row count,
+   the column count and the name and type of every column. Readers reject
+   tables whose magic or version differ.
+
+   Rows are buffered per column and written out as blocks of up to
+   BLOCK_ROW_COUNT rows. A block starts with its row count, followed by one
+   chunk per column. Every chunk starts with its size in bytes so readers
+   can skip columns they are not interested in.
+
+   - fixed width columns store their values back to back, so they can be
+     copied into R vectors directly.
+   - string columns start with a one byte encoding. STRING_ENCODING_PLAIN
+     chunks store the sizes of all values followed by their concatenated
+     bytes. STRING_ENCODING_DICTIONARY chunks store the number of entries
+     added to the column's dictionary in this block, their sizes and bytes,
+     followed by one code per value. Codes index the dictionary built up
+     over all previous blocks of the column. Columns are dictionary encoded
+     until their dictionary grows beyond DICTIONARY_SIZE_LIMIT entries,
+     after which the remaining blocks are plain. */
 class BinaryDataTableStream : public DataTableStream {
   public:
+    using block_size_t = std::uint64_t;
+
+    static const std::size_t BLOCK_ROW_COUNT;
+    static const std::size_t DICTIONARY_SIZE_LIMIT;
+    static const std::uint8_t STRING_ENCODING_PLAIN;
+    static const std::uint8_t STRING_ENCODING_DICTIONARY;
+    static const std::string MAGIC;
+    static const std::uint32_t FORMAT_VERSION;
+
     explicit BinaryDataTableStream(const std::string &table_filepath,
                                    const std::vector<std::string> &column_names,
-                                   bool truncate, int compression_level)
+                                   bool truncate, int compression_level,
+                                   int compression_threads)
         : DataTableStream(table_filepath, column_names, truncate,
-                          compression_level),
-          column_types_{column_names.size(), {NILSXP, 0}} {
+                          compression_level, compression_threads),
+          column_types_{column_names.size(), {NILSXP, 0}},
+          column_buffers_{column_names.size()}, block_row_count_{0} {
 
-        std::size_t header_buffer_size = 8;
+        std::size_t header_buffer_size = MAGIC.size() + 4 + 8;
 
         for (const auto &column_name : column_names) {
             header_buffer_size += 4 + column_name.size() + 4 + 4;
@@ -53,29 +84,44 @@ class BinaryDataTableStream : public DataTableStream {
     }
 
   private:
+    struct column_buffer_t {
+        column_buffer_t()
+            : entry_count{0}, encoding{STRING_ENCODING_DICTIONARY} {}
+        /* fixed width values, string sizes or dictionary codes */
+        std::string values;
+        /* string bytes or bytes of the dictionary entries of this block */
+        std::string strings;
+        /* sizes of the dictionary entries of this block */
+        std::string entry_sizes;
+        std::uint32_t entry_count;
+        std::unordered_map<std::string, std::uint32_t> dictionary;
+        std::uint8_t encoding;
+    };
+
     /* LGLSXP: sizeof(int) */
     void write_column_impl_(bool value) override {
-        store_or_check_column_type({LGLSXP, sizeof(bool)});
-        write(&value, sizeof(bool));
+        store_or_check_column_type({LGLSXP, sizeof(int)});
+        std::int32_t logical_value = value;
+        append_column_(&logical_value, sizeof(logical_value));
     }
 
     /* INTSXP: sizeof(int) */
     void write_column_impl_(int value) override {
         store_or_check_column_type({INTSXP, sizeof(int)});
-        int32_t int_value = value;
-        write(&int_value, sizeof(int_value));
+        std::int32_t int_value = value;
+        append_column_(&int_value, sizeof(int_value));
     }
 
-    /* INTSXP: sizeof(int) */
+    /* INTSXP: sizeof(uint8_t) */
     void write_column_impl_(uint8_t value) override {
         store_or_check_column_type({INTSXP, sizeof(uint8_t)});
-        write(&value, sizeof(value));
+        append_column_(&value, sizeof(value));
     }
 
     /* REALSXP: sizeof(double) */
     void write_column_impl_(double value) override {
-        store_or_check_column_type({REALSXP, sizeof(int)});
-        write(&value, sizeof(double));
+        store_or_check_column_type({REALSXP, sizeof(double)});
+        append_column_(&value, sizeof(double));
     }
 
     /* STRSXP: variable length */
@@ -91,16 +137,103 @@ class BinaryDataTableStream : public DataTableStream {
     }
 
     void write_string_column_(const char *value, uint32_t size) {
+        column_buffer_t &column_buffer =
+            column_buffers_[get_current_column_index()];
+
+        if (column_buffer.encoding == STRING_ENCODING_PLAIN) {
+            column_buffer.strings.append(value, size);
+            append_column_(&size, sizeof(size));
+            return;
+        }
+
+        auto result = column_buffer.dictionary.insert(
+            {std::string(value, size), column_buffer.dictionary.size()});
+
+        if (result.second) {
+            column_buffer.entry_sizes.append(
+                reinterpret_cast<const char *>(&size), sizeof(size));
+            column_buffer.strings.append(value, size);
+            ++column_buffer.entry_count;
+        }
+
+        std::uint32_t code = result.first->second;
+        append_column_(&code, sizeof(code));
+    }
+
+    void append_column_(const void *value, std::size_t size) {
+        column_buffers_[get_current_column_index()].values.append(
+            static_cast<const char *>(value), size);
+        if (is_last_column() && ++block_row_count_ == BLOCK_ROW_COUNT) {
+            write_block_();
+        }
+    }
+
+    void write_block_() {
+        std::uint32_t row_count = block_row_count_;
+        write(&row_count, sizeof(row_count));
+        for (std::size_t column_index = 0; column_index < get_column_count();
+             ++column_index) {
+            column_buffer_t &column_buffer = column_buffers_[column_index];
+            if (get_column_type(column_index).first == STRSXP) {
+                write_string_chunk_(column_buffer);
+            } else {
+                block_size_t size = column_buffer.values.size();
+                write(&size, sizeof(size));
+                write(column_buffer.values.data(), size);
+            }
+            column_buffer.values.clear();
+        }
+        block_row_count_ = 0;
+    }
+
+    void write_string_chunk_(column_buffer_t &column_buffer) {
+        const std::uint8_t encoding = column_buffer.encoding;
+        block_size_t size = sizeof(encoding) + column_buffer.values.size() +
+                            column_buffer.strings.size();
+
+        if (encoding == STRING_ENCODING_DICTIONARY) {
+            size += sizeof(column_buffer.entry_count) +
+                    column_buffer.entry_sizes.size();
+        }
+
         write(&size, sizeof(size));
-        write(value, size);
+        write(&encoding, sizeof(encoding));
+
+        if (encoding == STRING_ENCODING_DICTIONARY) {
+            write(&column_buffer.entry_count,
+                  sizeof(column_buffer.entry_count));
+            write(column_buffer.entry_sizes.data(),
+                  column_buffer.entry_sizes.size());
+            write(column_buffer.strings.data(), column_buffer.strings.size());
+            write(column_buffer.values.data(), column_buffer.values.size());
+            column_buffer.entry_sizes.clear();
+            column_buffer.entry_count = 0;
+            /* high cardinality columns gain nothing from the dictionary */
+            if (column_buffer.dictionary.size() > DICTIONARY_SIZE_LIMIT) {
+                column_buffer.encoding = STRING_ENCODING_PLAIN;
+                std::unordered_map<std::string, std::uint32_t>().swap(
+                    column_buffer.dictionary);
+            }
+        } else {
+            write(column_buffer.values.data(), column_buffer.values.size());
+            write(column_buffer.strings.data(), column_buffer.strings.size());
+        }
+
+        column_buffer.strings.clear();
     }
-    /* TODO - first compress the stream, then write the size in the beginning.
-              Do not compress the size as well. This is very important.
-              The size value is updated in the end with the correct size,
-              if it is compressed, then it can't be updated. */
+
+    /* The header is never compressed. Space for it is reserved in the
+       constructor directly in the buffer stream, below the compression
+       stream, and it is filled in here once the row count is known. Only
+       the rows that follow the header form the compressed payload. */
     void write_header_() {
+        if (block_row_count_ != 0) {
+            write_block_();
+        }
         finalize();
         seek(0, SEEK_SET);
+        write(MAGIC.data(), MAGIC.size());
+        write(&FORMAT_VERSION, sizeof(FORMAT_VERSION));
         std::uint32_t size = get_current_row_index();
         write(&size, sizeof(size));
         size = get_column_count();
@@ -120,6 +253,8 @@ class BinaryDataTableStream : public DataTableStream {
         }
     }
     std::vector<column_type_t> column_types_;
+    std::vector<column_buffer_t> column_buffers_;
+    std::size_t block_row_count_;
 };
 
 #endif /* PROMISEDYNTRACER_BINARY_DATA_TABLE_STREAM_H */
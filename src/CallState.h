@@ -6,6 +6,7 @@
 #include "State.h"
 #include "table.h"
 #include "utilities.h"
+#include <memory>
 
 class CallState {
   public:
@@ -16,18 +17,29 @@ class CallState {
         : call_id_{call_id}, fn_id_{fn_id}, function_type_(function_type),
           function_name_(function_name),
           formal_parameter_count_{formal_parameter_count},
-          parameter_uses_{
-              static_cast<std::size_t>(std::max(formal_parameter_count, 0))},
-          order_{order}, intrinsic_order_{order},
-          return_value_type_{UNASSIGNEDSXP}, leaf_(true), active_(true) {
+          parameter_uses_{inline_parameter_uses_}, order_{order},
+          intrinsic_order_{order},
+          return_value_type_{UNASSIGNEDSXP}, leaf_(true), active_(true),
+          argument_promise_count_{0} {
 
         /* INFO - Reserve size to 15 bytes to prevent repeated string
          * allocations when forced arguments are added. This increases
          * the memory requirement but should speed up the program. */
         order_.reserve(15);
         intrinsic_order_.reserve(15);
+
+        /* most functions have few parameters, their uses are stored inline
+           so that creating a call state does not allocate for them */
+        if (formal_parameter_count > INLINE_PARAMETER_COUNT) {
+            spilled_parameter_uses_.reset(
+                new ParameterUse[formal_parameter_count]);
+            parameter_uses_ = spilled_parameter_uses_.get();
+        }
     }
 
+    CallState(const CallState &) = delete;
+    CallState &operator=(const CallState &) = delete;
+
     call_id_t get_call_id() const { return call_id_; }
 
     const fn_id_t &get_function_id() const { return fn_id_; }
@@ -46,6 +58,13 @@ class CallState {
 
     void make_inactive() { active_ = false; }
 
+    /* argument promises that can still report uses to this call */
+    void add_argument_promise() { ++argument_promise_count_; }
+
+    void remove_argument_promise() { --argument_promise_count_; }
+
+    bool has_argument_promises() const { return argument_promise_count_ != 0; }
+
     void set_return_value_type(sexptype_t return_value_type) {
         return_value_type_ = return_value_type;
     }
@@ -111,31 +130,35 @@ class CallState {
         parameter_uses_[position].set_parameter_mode(mode);
     }
 
-    const std::vector<ParameterUse> &get_parameter_uses() const {
-        return parameter_uses_;
-    }
+    /* one per formal parameter */
+    const ParameterUse *get_parameter_uses() const { return parameter_uses_; }
 
     const std::string &get_order() const { return order_; }
 
     const std::string &get_intrinsic_order() const { return intrinsic_order_; }
 
   private:
+    static constexpr int INLINE_PARAMETER_COUNT = 8;
+
     call_id_t call_id_;
     fn_id_t fn_id_;
     std::string function_type_;
     std::string function_name_;
     int formal_parameter_count_;
-    std::vector<ParameterUse> parameter_uses_;
+    ParameterUse *parameter_uses_;
+    ParameterUse inline_parameter_uses_[INLINE_PARAMETER_COUNT];
+    std::unique_ptr<ParameterUse[]> spilled_parameter_uses_;
     std::string order_;
     std::string intrinsic_order_;
     sexptype_t return_value_type_;
     bool leaf_;
     bool active_;
+    int argument_promise_count_;
 };
 
 inline std::ostream &operator<<(std::ostream &os, const CallState &call_state) {
-    os << "CallState(" << call_state.get_function_id() << ","
-       << call_state.get_call_id() << ","
+    os << "CallState(" << fn_id_to_string(call_state.get_function_id())
+       << "," << call_state.get_call_id() << ","
        << call_state.get_formal_parameter_count() << ")";
     return os;
 }
@@ -4,6 +4,8 @@
 #include "AnalysisDriver.h"
 #include "AnalysisSwitch.h"
 #include "DebugSerializer.h"
+#include "Sampler.h"
+#include "SamplingSwitch.h"
 #include "State.h"
 #include "TraceSerializer.h"
 #include <string>
@@ -12,21 +14,40 @@ class Context {
   public:
     Context(std::string trace_filepath, bool truncate, bool enable_trace,
             bool verbose, std::string output_dir, bool binary,
-            int compression_level, AnalysisSwitch analysis_switch)
+            int compression_level, int compression_threads,
+            AnalysisSwitch analysis_switch, SamplingSwitch sampling_switch,
+            bool binary_trace, int trace_compression_level)
         : state_(new tracer_state_t()), analysis_switch_{analysis_switch},
-          serializer_(
-              new TraceSerializer(trace_filepath, truncate, enable_trace)),
-          driver_(new AnalysisDriver(*state_, verbose, output_dir, truncate,
-                                     binary, compression_level,
-                                     analysis_switch)),
+          sampler_(new Sampler(sampling_switch)),
+          serializer_(new TraceSerializer(
+              trace_filepath, truncate, enable_trace, binary_trace,
+              trace_compression_level, compression_threads, *sampler_)),
+          driver_(AnalysisDriver::create(
+              *state_, *sampler_, verbose, output_dir, truncate, binary,
+              compression_level, compression_threads, analysis_switch)),
           debugger_(new DebugSerializer(verbose)), output_dir_{output_dir},
           binary_{binary}, verbose_{verbose}, truncate_{truncate},
-          compression_level_{compression_level} {}
+          compression_level_{compression_level},
+          compression_threads_{compression_threads} {
+        if (verbose) {
+            std::cout << sampling_switch;
+        }
+        /* the debug serializer prints every field */
+        call_info_fields_ =
+            verbose ? CALL_INFO_ALL : driver_->get_call_info_fields();
+        /* the trace and the debug serializer record every event */
+        probe_groups_ = enable_trace || verbose ? PROBES_ALL
+                                                : driver_->get_probe_groups();
+    }
 
     tracer_state_t &get_state() { return *state_; }
 
     TraceSerializer &get_serializer() { return *serializer_; }
 
+    Sampler &get_sampler() { return *sampler_; }
+
+    const Sampler &get_sampler() const { return *sampler_; }
+
     DebugSerializer &get_debug_serializer() {
         if (debugger_->needsState())
             debugger_->setState(&get_state());
@@ -39,6 +60,14 @@ class Context {
 
     int get_compression_level() const { return compression_level_; }
 
+    int get_compression_threads() const { return compression_threads_; }
+
+    call_info_fields_t get_call_info_fields() const {
+        return call_info_fields_;
+    }
+
+    probe_groups_t get_probe_groups() const { return probe_groups_; }
+
     bool is_binary() const { return binary_; }
 
     bool is_verbose() const { return verbose_; }
@@ -54,6 +83,7 @@ class Context {
         delete debugger_;
         delete driver_;
         delete serializer_;
+        delete sampler_;
         /* delete state in the end as everything else
            can store reference to the state */
         delete state_;
@@ -62,6 +92,7 @@ class Context {
   private:
     tracer_state_t *state_;
     AnalysisSwitch analysis_switch_;
+    Sampler *sampler_;
     TraceSerializer *serializer_;
     AnalysisDriver *driver_;
     DebugSerializer *debugger_;
@@ -70,6 +101,9 @@ class Context {
     bool verbose_;
     bool truncate_;
     int compression_level_;
+    int compression_threads_;
+    call_info_fields_t call_info_fields_;
+    probe_groups_t probe_groups_;
 };
 
 inline Context &tracer_context(dyntracer_t *dyntracer) {
@@ -84,6 +118,10 @@ inline TraceSerializer &tracer_serializer(dyntracer_t *dyntracer) {
     return (static_cast<Context *>(dyntracer->state))->get_serializer();
 }
 
+inline Sampler &sampler(dyntracer_t *dyntracer) {
+    return (static_cast<Context *>(dyntracer->state))->get_sampler();
+}
+
 inline DebugSerializer &debug_serializer(dyntracer_t *dyntracer) {
     return (static_cast<Context *>(dyntracer->state))->get_debug_serializer();
 }
@@ -1,11 +1,13 @@
 #ifndef PROMISEDYNTRACER_DATA_TABLE_STREAM_H
 #define PROMISEDYNTRACER_DATA_TABLE_STREAM_H
 
+#include "AsyncStream.h"
 #include "BufferStream.h"
 #include "FileStream.h"
 #include "Stream.h"
 #include "ZstdCompressionStream.h"
 #include "sexptypes.h"
+#include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -17,12 +19,12 @@ class DataTableStream : public Stream {
 
     DataTableStream(const std::string &table_filepath,
                     const std::vector<std::string> &column_names, bool truncate,
-                    int compression_level)
+                    int compression_level, int compression_threads)
         : Stream(nullptr), table_filepath_{table_filepath},
           column_names_{column_names}, column_count_{column_names.size()},
           current_row_index_{0}, current_column_index_{0},
           file_stream_{nullptr}, buffer_stream_{nullptr},
-          zstd_compression_stream_{nullptr} {
+          zstd_compression_stream_{nullptr}, async_stream_{nullptr} {
 
         int flags = O_WRONLY | O_CREAT;
         flags = truncate ? flags | O_TRUNC : flags;
@@ -32,14 +34,23 @@ class DataTableStream : public Stream {
 
         if (compression_level > 0) {
             zstd_compression_stream_ =
-                new ZstdCompressionStream(buffer_stream_, compression_level);
-            set_sink(zstd_compression_stream_);
+                new ZstdCompressionStream(buffer_stream_, compression_level,
+                                          compression_threads);
+            async_stream_ = new AsyncStream(zstd_compression_stream_,
+                                            ASYNC_BLOCK_CAPACITY,
+                                            ASYNC_BLOCK_COUNT);
         } else {
-            set_sink(buffer_stream_);
+            async_stream_ = new AsyncStream(buffer_stream_,
+                                            ASYNC_BLOCK_CAPACITY,
+                                            ASYNC_BLOCK_COUNT);
         }
+        set_sink(async_stream_);
     }
 
+    /* writes below the compression stream and the writer thread, for the
+       uncompressed header placeholder written before any row */
     void fill(char byte, std::size_t count) {
+        assert(async_stream_->is_unused());
         buffer_stream_->fill(byte, count);
     }
 
@@ -49,8 +60,11 @@ class DataTableStream : public Stream {
 
     void finalize() {
         if (is_compression_enabled()) {
+            /* the writer thread has to be idle before the compression stream
+               can be finalized from this thread. */
+            async_stream_->flush();
             zstd_compression_stream_->finalize();
-            set_sink(buffer_stream_);
+            async_stream_->set_sink(buffer_stream_);
         }
     }
 
@@ -126,6 +140,7 @@ class DataTableStream : public Stream {
 
     virtual ~DataTableStream() {
         flush();
+        delete async_stream_;
         if (is_compression_enabled()) {
             delete zstd_compression_stream_;
         }
@@ -136,6 +151,11 @@ class DataTableStream : public Stream {
     static std::size_t get_buffer_size();
 
   private:
+    /* most tables receive far fewer rows than the trace, so their writer
+       threads get smaller and fewer blocks than the AsyncStream default */
+    static const std::size_t ASYNC_BLOCK_CAPACITY = 256 * 1024;
+    static const std::size_t ASYNC_BLOCK_COUNT = 4;
+
     virtual void write_column_impl_(bool value) = 0;
     virtual void write_column_impl_(int value) = 0;
     virtual void write_column_impl_(std::uint8_t value) = 0;
@@ -153,6 +173,7 @@ class DataTableStream : public Stream {
     FileStream *file_stream_;
     BufferStream *buffer_stream_;
     ZstdCompressionStream *zstd_compression_stream_;
+    AsyncStream *async_stream_;
 };
 
 #endif /* PROMISEDYNTRACER_DATA_TABLE_STREAM_H */
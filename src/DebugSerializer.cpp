@@ -80,7 +80,8 @@ string DebugSerializer::log_line(const full_sexp_type &type) {
 string DebugSerializer::log_line(const builtin_info_t &info) {
     stringstream line;
     line << log_line(info.fn_type) << " name=" << info.name
-         << " fn_id=" << info.fn_id << " call_id=" << info.call_id
+         << " fn_id=" << fn_id_to_string(info.fn_id)
+         << " call_id=" << info.call_id
          //<< " env_ptr=" << info.call_ptr
          << " parent=" << log_line(info.parent_on_stack)
          << " parent_call_id=" << info.parent_call_id
@@ -95,7 +96,8 @@ string DebugSerializer::log_line(const builtin_info_t &info) {
 string DebugSerializer::log_line(const closure_info_t &info) {
     stringstream line;
     line << log_line(info.fn_type) << " name=" << info.name
-         << " fn_id=" << info.fn_id << " call_id=" << info.call_id
+         << " fn_id=" << fn_id_to_string(info.fn_id)
+         << " call_id=" << info.call_id
          //<< " env_ptr=" << info.call_ptr
          << " args=" << log_line(info.arguments)
          << " parent=" << log_line(info.parent_on_stack)
@@ -314,7 +316,7 @@ void DebugSerializer::serialize_new_environment(const env_id_t env_id,
     if (!verbose)
         return;
     cerr << prefix() << "new_environment env_id=" << env_id
-         << " fun_id=" << fun_id << print_stack() << endl;
+         << " fun_id=" << fn_id_to_string(fun_id) << print_stack() << endl;
 }
 
 void DebugSerializer::serialize_begin_ctxt(const RCNTXT *cptr) {
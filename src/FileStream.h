@@ -12,6 +12,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <tuple>
 #include <unistd.h>
 #include <utility>
 #include <zstd.h>
@@ -21,6 +22,32 @@ void close_file(int fd, const std::string &filepath);
 std::pair<void *, std::size_t> map_to_memory(const std::string &filepath);
 void unmap_memory(void *data, std::size_t size);
 
+/* Maps a file for reading and unmaps it on destruction, including when its
+   reader unwinds with an exception. Empty files map to a null pointer. */
+class MemoryMapping {
+  public:
+    explicit MemoryMapping(const std::string &filepath) {
+        std::tie(data_, size_) = map_to_memory(filepath);
+    }
+
+    MemoryMapping(const MemoryMapping &) = delete;
+    MemoryMapping &operator=(const MemoryMapping &) = delete;
+
+    const char *data() const { return static_cast<const char *>(data_); }
+
+    std::size_t size() const { return size_; }
+
+    ~MemoryMapping() {
+        if (data_ != nullptr) {
+            unmap_memory(data_, size_);
+        }
+    }
+
+  private:
+    void *data_;
+    std::size_t size_;
+};
+
 class FileStream : public Stream {
   public:
     FileStream(const std::string &filepath, int flags, int mode = 0666)
@@ -0,0 +1,274 @@
+#ifndef PROMISEDYNTRACER_FLAT_HASH_MAP_H
+#define PROMISEDYNTRACER_FLAT_HASH_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Open addressing hash map with linear probing. Entries live in one flat
+   array, so a lookup touches one or two cache lines instead of chasing a
+   bucket list. The hash of the key is scrambled by a Fibonacci multiply
+   and the top bits select the slot, so identity hashes of SEXP addresses and
+   sequential ids, whose low bits carry little information, spread evenly.
+   Erasing shifts the following entries back instead of leaving tombstones.
+   Inserting and erasing invalidate iterators and references to entries. */
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class FlatHashMap {
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+
+    template <bool CONST> class Iterator {
+        using map_t =
+            typename std::conditional<CONST, const FlatHashMap,
+                                      FlatHashMap>::type;
+
+      public:
+        using reference =
+            typename std::conditional<CONST, const value_type &,
+                                      value_type &>::type;
+        using pointer = typename std::conditional<CONST, const value_type *,
+                                                  value_type *>::type;
+
+        Iterator(map_t *map, std::size_t index) : map_(map), index_(index) {
+            skip_empty_();
+        }
+
+        operator Iterator<true>() const { return {map_, index_}; }
+
+        reference operator*() const { return map_->slots_[index_]; }
+
+        pointer operator->() const { return &map_->slots_[index_]; }
+
+        Iterator &operator++() {
+            ++index_;
+            skip_empty_();
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator &other) const {
+            return index_ != other.index_;
+        }
+
+      private:
+        void skip_empty_() {
+            while (index_ < map_->slots_.size() && !map_->occupied_[index_]) {
+                ++index_;
+            }
+        }
+
+        map_t *map_;
+        std::size_t index_;
+
+        friend class FlatHashMap;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit FlatHashMap(std::size_t capacity = MINIMUM_CAPACITY)
+        : size_(0) {
+        allocate_(round_capacity_(capacity));
+    }
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, slots_.size()}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, slots_.size()}; }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    iterator find(const K &key) {
+        return {this, find_index_(key)};
+    }
+
+    const_iterator find(const K &key) const {
+        return {this, find_index_(key)};
+    }
+
+    std::size_t count(const K &key) const {
+        return find_index_(key) != slots_.size();
+    }
+
+    /* inserts an entry with a value constructed from args unless the key is
+       present, in which case nothing is constructed */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args &&... args) {
+        std::size_t index = find_index_(key);
+        if (index != slots_.size()) {
+            return {iterator(this, index), false};
+        }
+        if ((size_ + 1) * MAXIMUM_LOAD_DENOMINATOR >
+            slots_.size() * MAXIMUM_LOAD_NUMERATOR) {
+            rehash_(slots_.size() * 2);
+        }
+        index = insert_index_(key);
+        slots_[index].first = key;
+        slots_[index].second = V{std::forward<Args>(args)...};
+        occupied_[index] = true;
+        ++size_;
+        return {iterator(this, index), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        return try_emplace(value.first, value.second);
+    }
+
+    V &operator[](const K &key) { return try_emplace(key).first->second; }
+
+    void erase(const_iterator position) { erase_index_(position.index_); }
+
+    std::size_t erase(const K &key) {
+        std::size_t index = find_index_(key);
+        if (index == slots_.size()) {
+            return 0;
+        }
+        erase_index_(index);
+        return 1;
+    }
+
+    void clear() {
+        for (std::size_t index = 0; index < slots_.size(); ++index) {
+            if (occupied_[index]) {
+                slots_[index] = value_type();
+                occupied_[index] = false;
+            }
+        }
+        size_ = 0;
+    }
+
+    void reserve(std::size_t count) {
+        std::size_t capacity = round_capacity_(
+            count * MAXIMUM_LOAD_DENOMINATOR / MAXIMUM_LOAD_NUMERATOR + 1);
+        if (capacity > slots_.size()) {
+            rehash_(capacity);
+        }
+    }
+
+  private:
+    static const std::size_t MINIMUM_CAPACITY = 16;
+    static const std::size_t MAXIMUM_LOAD_NUMERATOR = 3;
+    static const std::size_t MAXIMUM_LOAD_DENOMINATOR = 4;
+    static const std::uint64_t FIBONACCI_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+    static std::size_t round_capacity_(std::size_t capacity) {
+        std::size_t result = MINIMUM_CAPACITY;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    void allocate_(std::size_t capacity) {
+        slots_ = std::vector<value_type>(capacity);
+        occupied_ = std::vector<unsigned char>(capacity, false);
+        shift_ = 64;
+        for (std::size_t bits = capacity; bits > 1; bits /= 2) {
+            --shift_;
+        }
+        mask_ = capacity - 1;
+    }
+
+    std::size_t home_index_(const K &key) const {
+        return static_cast<std::size_t>(
+            (static_cast<std::uint64_t>(hasher_(key)) * FIBONACCI_MULTIPLIER) >>
+            shift_);
+    }
+
+    /* returns slots_.size() if the key is absent */
+    std::size_t find_index_(const K &key) const {
+        for (std::size_t index = home_index_(key);;
+             index = (index + 1) & mask_) {
+            if (!occupied_[index]) {
+                return slots_.size();
+            }
+            if (key_equal_(slots_[index].first, key)) {
+                return index;
+            }
+        }
+    }
+
+    /* returns the first free slot of the key's probe sequence */
+    std::size_t insert_index_(const K &key) const {
+        std::size_t index = home_index_(key);
+        while (occupied_[index]) {
+            index = (index + 1) & mask_;
+        }
+        return index;
+    }
+
+    /* Moves back every following entry of the run whose home slot does not
+       lie between the hole and itself, so that lookups never stop at an
+       empty slot before reaching their key. */
+    void erase_index_(std::size_t hole) {
+        for (std::size_t index = (hole + 1) & mask_; occupied_[index];
+             index = (index + 1) & mask_) {
+            std::size_t home = home_index_(slots_[index].first);
+            if (((index - home) & mask_) >= ((index - hole) & mask_)) {
+                slots_[hole] = std::move(slots_[index]);
+                hole = index;
+            }
+        }
+        slots_[hole] = value_type();
+        occupied_[hole] = false;
+        --size_;
+    }
+
+    void rehash_(std::size_t capacity) {
+        std::vector<value_type> slots(std::move(slots_));
+        std::vector<unsigned char> occupied(std::move(occupied_));
+        allocate_(capacity);
+        for (std::size_t index = 0; index < slots.size(); ++index) {
+            if (occupied[index]) {
+                std::size_t new_index = insert_index_(slots[index].first);
+                slots_[new_index] = std::move(slots[index]);
+                occupied_[new_index] = true;
+            }
+        }
+    }
+
+    std::vector<value_type> slots_;
+    std::vector<unsigned char> occupied_;
+    std::size_t size_;
+    std::size_t mask_;
+    int shift_;
+    Hash hasher_;
+    KeyEqual key_equal_;
+};
+
+/* Set counterpart of FlatHashMap, with the same iterator invalidation. */
+template <typename K, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class FlatHashSet {
+  public:
+    explicit FlatHashSet(std::size_t capacity = 16) : map_(capacity) {}
+
+    std::size_t size() const { return map_.size(); }
+
+    bool empty() const { return map_.empty(); }
+
+    std::size_t count(const K &key) const { return map_.count(key); }
+
+    /* returns true if the key was not present */
+    bool insert(const K &key) { return map_.try_emplace(key).second; }
+
+    std::size_t erase(const K &key) { return map_.erase(key); }
+
+    void clear() { map_.clear(); }
+
+  private:
+    FlatHashMap<K, bool, Hash, KeyEqual> map_;
+};
+
+#endif /* PROMISEDYNTRACER_FLAT_HASH_MAP_H */
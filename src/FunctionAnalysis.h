@@ -10,7 +10,7 @@ class FunctionAnalysis {
   public:
     FunctionAnalysis(const tracer_state_t &tracer_state,
                      const std::string &output_dir, bool truncate, bool binary,
-                     int compression_level)
+                     int compression_level, int compression_threads)
         : tracer_state_{tracer_state}, output_dir_{output_dir},
           closure_type_{sexptype_to_string(CLOSXP)},
           builtin_type_{sexptype_to_string(BUILTINSXP)},
@@ -19,7 +19,7 @@ class FunctionAnalysis {
               output_dir + "/" + "functions",
               {"function_id", "function_name", "function_type", "return_type",
                "parameter_count", "call_count"},
-              truncate, binary, compression_level)} {}
+              truncate, binary, compression_level, compression_threads)} {}
 
     void closure_entry(const closure_info_t &closure_info) {
         push_function_(closure_info.fn_id, closure_info.name, closure_type_,
@@ -64,7 +64,7 @@ class FunctionAnalysis {
 
   private:
     struct function_key_t {
-        std::string function_id;
+        fn_id_t function_id;
         std::string function_name;
         std::string function_type;
         std::string return_type;
@@ -82,7 +82,8 @@ class FunctionAnalysis {
     void serialize() {
         for (const auto &key_value : functions_) {
             function_data_table_->write_row(
-                key_value.first.function_id, key_value.first.function_name,
+                fn_id_to_string(key_value.first.function_id),
+                key_value.first.function_name,
                 key_value.first.function_type, key_value.first.return_type,
                 key_value.first.parameter_count, key_value.second);
         }
@@ -93,7 +94,7 @@ class FunctionAnalysis {
         auto result = handled_functions_.insert(fn_id);
         if (!result.second)
             return;
-        std::ofstream fout(output_dir_ + "/functions/" + fn_id,
+        std::ofstream fout(output_dir_ + "/functions/" + fn_id_to_string(fn_id),
                            std::ios::trunc);
         fout << definition;
         fout.close();
@@ -121,7 +122,7 @@ class FunctionAnalysis {
             // Compute individual hash values for first, second and third
             // http://stackoverflow.com/a/1646913/126995
             std::size_t res = 17;
-            res = res * 31 + std::hash<std::string>()(key.function_id);
+            res = res * 31 + std::hash<fn_id_t>()(key.function_id);
             res = res * 31 + std::hash<std::string>()(key.function_name);
             res = res * 31 + std::hash<std::string>()(key.function_type);
             res = res * 31 + std::hash<std::string>()(key.return_type);
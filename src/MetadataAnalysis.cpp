@@ -91,6 +91,7 @@ void MetadataAnalysis::end(dyntracer_t *dyntracer) {
     timer_serializer(Timer::main_timer());
     timer_serializer(Timer::recorder_timer());
     timer_serializer(Timer::analysis_timer());
+    timer_serializer(Timer::analyses_timer());
 
 #endif
 }
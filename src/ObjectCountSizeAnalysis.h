@@ -1,6 +1,7 @@
 #ifndef __OBJECT_COUNT_SIZE_ANALYSIS_H__
 #define __OBJECT_COUNT_SIZE_ANALYSIS_H__
 
+#include "Analysis.h"
 #include "State.h"
 #include <algorithm>
 #include <tuple>
@@ -8,7 +9,7 @@
 #include <vector>
 #include "utilities.h"
 
-class ObjectCountSizeAnalysis {
+class ObjectCountSizeAnalysis : public Analysis {
   public:
     ObjectCountSizeAnalysis(const tracer_state_t &tracer_state,
                             const std::string &output_dir);
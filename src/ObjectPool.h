@@ -0,0 +1,116 @@
+#ifndef PROMISEDYNTRACER_OBJECT_POOL_H
+#define PROMISEDYNTRACER_OBJECT_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/* Hands out storage for objects of type T from slabs of SLAB_SIZE objects.
+   Released storage goes on a free list and is handed out again before a new
+   slab is allocated, so objects that are created and destroyed at a high
+   rate recycle the same few cache lines instead of going through malloc.
+   Slabs are returned to the system when the pool is destroyed, all objects
+   created from it have to be destroyed before. */
+template <typename T, std::size_t SLAB_SIZE = 1024> class ObjectPool {
+  public:
+    ObjectPool() : free_list_{nullptr} {}
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() {
+        for (slot_t *slab : slabs_) {
+            delete[] slab;
+        }
+    }
+
+    template <typename... Args> T *create(Args &&... args) {
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T *object) {
+        object->~T();
+        deallocate(object);
+    }
+
+    void *allocate() {
+        if (free_list_ == nullptr) {
+            allocate_slab_();
+        }
+        slot_t *slot = free_list_;
+        free_list_ = slot->next;
+        return slot->storage;
+    }
+
+    void deallocate(void *storage) {
+        slot_t *slot = static_cast<slot_t *>(storage);
+        slot->next = free_list_;
+        free_list_ = slot;
+    }
+
+  private:
+    union slot_t {
+        slot_t *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    /* slots are put on the free list back to front, so that they are
+       handed out in address order */
+    void allocate_slab_() {
+        slot_t *slab = new slot_t[SLAB_SIZE];
+        slabs_.push_back(slab);
+        for (std::size_t index = SLAB_SIZE; index != 0; --index) {
+            slab[index - 1].next = free_list_;
+            free_list_ = &slab[index - 1];
+        }
+    }
+
+    slot_t *free_list_;
+    std::vector<slot_t *> slabs_;
+};
+
+/* Allocator for node based containers. Nodes come from a pool shared by all
+   containers of the same node type, arrays (bucket tables) go through
+   operator new. Meant for the tracer's single thread. */
+template <typename T> class PoolAllocator {
+  public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(std::size_t count) {
+        if (count == 1) {
+            return static_cast<T *>(get_pool_().allocate());
+        }
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, std::size_t count) {
+        if (count == 1) {
+            get_pool_().deallocate(pointer);
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+  private:
+    static ObjectPool<T> &get_pool_() {
+        static ObjectPool<T> pool;
+        return pool;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return false;
+}
+
+#endif /* PROMISEDYNTRACER_OBJECT_POOL_H */
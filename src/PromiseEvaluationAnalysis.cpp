@@ -47,10 +47,10 @@ void PromiseEvaluationAnalysis::compute_evaluation_distance(
                                   std::to_string(promise_count);
                 update_evaluation_distance(key);
                 return;
-            } else if (exec_context.function_info.type ==
+            } else if (exec_context.fn_type ==
                        function_type::CLOSURE)
                 closure_count++;
-            else if (exec_context.function_info.type == function_type::SPECIAL)
+            else if (exec_context.fn_type == function_type::SPECIAL)
                 special_count++;
             else
                 builtin_count++;
@@ -71,22 +71,22 @@ void PromiseEvaluationAnalysis::end(dyntracer_t *dyntracer) { serialize(); }
 PromiseEvaluationAnalysis::EvaluationContext
 PromiseEvaluationAnalysis::get_current_evaluation_context() {
 
-    size_t stack_size = tracer_state_.full_stack.size();
-    for (int i = stack_size - 1; i >= 0; --i) {
-        stack_event_t exec_context = tracer_state_.full_stack[i];
-        if (exec_context.type == stack_type::CALL) {
-            if (exec_context.function_info.type == function_type::CLOSURE)
-                return EvaluationContext::CLOSURE;
-            else if (exec_context.function_info.type == function_type::SPECIAL)
-                return EvaluationContext::SPECIAL;
-            else
-                return EvaluationContext::BUILTIN;
-
-        } else if (exec_context.type == stack_type::PROMISE) {
-            return EvaluationContext::CLOSURE;
-        }
-    }
-    return EvaluationContext::GLOBAL;
+    const ExecutionStack &stack = tracer_state_.full_stack;
+    int call_index = stack.last_index(stack_type::CALL);
+    int promise_index = stack.last_index(stack_type::PROMISE);
+
+    if (promise_index > call_index)
+        return EvaluationContext::CLOSURE;
+    if (call_index < 0)
+        return EvaluationContext::GLOBAL;
+
+    const stack_event_t &exec_context = stack[call_index];
+    if (exec_context.fn_type == function_type::CLOSURE)
+        return EvaluationContext::CLOSURE;
+    else if (exec_context.fn_type == function_type::SPECIAL)
+        return EvaluationContext::SPECIAL;
+    else
+        return EvaluationContext::BUILTIN;
 }
 
 void PromiseEvaluationAnalysis::update_evaluation_context_count(
@@ -1,6 +1,7 @@
 #ifndef __PROMISE_EVALUATION_ANALYSIS_H__
 #define __PROMISE_EVALUATION_ANALYSIS_H__
 
+#include "Analysis.h"
 #include "PromiseMapper.h"
 #include "PromiseState.h"
 #include "State.h"
@@ -9,7 +10,7 @@
 #include <unordered_map>
 #include <vector>
 
-class PromiseEvaluationAnalysis {
+class PromiseEvaluationAnalysis : public Analysis {
   public:
     enum class EvaluationContext {
         PROMISE = 0,
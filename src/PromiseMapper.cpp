@@ -2,11 +2,12 @@
 
 const size_t PromiseMapper::PROMISE_MAPPING_BUCKET_COUNT = 1000000;
 
+const probe_groups_t PromiseMapper::PROBE_GROUPS = PROBES_PROMISE_SLOT;
+
 PromiseMapper::PromiseMapper(tracer_state_t &tracer_state,
                              const std::string &output_dir)
     : tracer_state_(tracer_state), output_dir_(output_dir),
-      promises_(std::unordered_map<prom_id_t, PromiseState>(
-          PROMISE_MAPPING_BUCKET_COUNT)) {}
+      promises_(PROMISE_MAPPING_BUCKET_COUNT) {}
 
 void PromiseMapper::promise_created(const prom_basic_info_t &prom_basic_info,
                                     const SEXP promise) {
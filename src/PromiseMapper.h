@@ -1,6 +1,8 @@
 #ifndef __PROMISE_MAPPER_H__
 #define __PROMISE_MAPPER_H__
 
+#include "Analysis.h"
+#include "ObjectPool.h"
 #include "PromiseState.h"
 #include "State.h"
 #include <algorithm>
@@ -8,13 +10,21 @@
 #include <unordered_map>
 #include <vector>
 
-class PromiseMapper {
-    using promises_t = std::unordered_map<prom_id_t, PromiseState>;
+class PromiseMapper : public Analysis {
+    /* promises come and go at a high rate, their nodes are recycled */
+    using promises_t = std::unordered_map<
+        prom_id_t, PromiseState, std::hash<prom_id_t>, std::equal_to<prom_id_t>,
+        PoolAllocator<std::pair<const prom_id_t, PromiseState>>>;
 
   public:
     using iterator = promises_t::iterator;
     using const_iterator = promises_t::const_iterator;
 
+    static const probe_groups_t PROBE_GROUPS;
+    /* the other analyses look up every promise they see in the mapper, so
+       it has to see all of them */
+    static constexpr bool SAMPLED = false;
+
     PromiseMapper(tracer_state_t &tracer_state, const std::string &output_dir);
     void promise_created(const prom_basic_info_t &prom_basic_info,
                          const SEXP promise);
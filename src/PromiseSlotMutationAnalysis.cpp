@@ -61,13 +61,11 @@ void PromiseSlotMutationAnalysis::update_promise_argument_slot(
 
 bool PromiseSlotMutationAnalysis::promise_is_being_forced_(
     const prom_id_t prom_id) {
-    auto stack = tracer_state_.full_stack;
-    for (auto iter = stack.crbegin(); iter != stack.crend(); ++iter) {
-        auto element = *iter;
-        if (element.type == stack_type::PROMISE) {
-            if (element.promise_id == prom_id)
-                return true;
-        }
+    const ExecutionStack &stack = tracer_state_.full_stack;
+    for (int index = stack.last_index(stack_type::PROMISE); index >= 0;
+         index = stack.previous_index(index, stack_type::PROMISE)) {
+        if (stack[index].promise_id == prom_id)
+            return true;
     }
     return false;
 }
@@ -3,6 +3,7 @@
 
 #include "State.h"
 #include "utilities.h"
+#include <array>
 
 class PromiseState {
   public:
@@ -25,7 +26,7 @@ class PromiseState {
     int formal_parameter_position;
     parameter_mode_t parameter_mode;
     bool evaluated;
-    std::vector<int> mutations;
+    std::array<int, static_cast<std::size_t>(SlotMutation::COUNT)> mutations;
 
     PromiseState(prom_id_t id, env_id_t env_, bool local);
 
@@ -3,18 +3,21 @@
 PromiseTypeAnalysis::PromiseTypeAnalysis(const tracer_state_t &tracer_state,
                                          const std::string &output_dir,
                                          bool truncate, bool binary,
-                                         int compression_level)
+                                         int compression_level,
+                                         int compression_threads)
     : tracer_state_(tracer_state),
       output_dir_(output_dir), evaluated_data_table_{create_data_table(
                                    output_dir + "/" + "evaluated-promise-type",
                                    {"promise_type", "promise_expression_type",
                                     "promise_value_type", "count"},
-                                   truncate, binary, compression_level)},
+                                   truncate, binary, compression_level,
+                                   compression_threads)},
       unevaluated_data_table_{
           create_data_table(output_dir + "/" + "unevaluated-promise-type",
                             {"promise_type", "promise_expression_type",
                              "inferred_promise_value_type", "count"},
-                            truncate, binary, compression_level)} {
+                            truncate, binary, compression_level,
+                            compression_threads)} {
 
     for (int i = 0; i < MAX_NUM_SEXPTYPE; ++i) {
         for (int j = 0; j < MAX_NUM_SEXPTYPE; ++j) {
@@ -1,15 +1,17 @@
 #ifndef PROMISEDYNTRACER_TYPE_ANALYSIS_H
 #define PROMISEDYNTRACER_TYPE_ANALYSIS_H
 
+#include "Analysis.h"
 #include "State.h"
 #include "table.h"
 #include "utilities.h"
 
-class PromiseTypeAnalysis {
+class PromiseTypeAnalysis : public Analysis {
   public:
     PromiseTypeAnalysis(const tracer_state_t &tracer_state,
                         const std::string &output_dir, bool truncate,
-                        bool binary, int compression_level);
+                        bool binary, int compression_level,
+                        int compression_threads);
     void promise_created(const prom_basic_info_t &prom_basic_info,
                          const SEXP promise);
     void closure_entry(const closure_info_t &closure_info);
@@ -0,0 +1,31 @@
+#include "Sampler.h"
+#include "utilities.h"
+#include <cmath>
+
+bool Sampler::sample_closure_(const ExecutionStack &stack,
+                              const fn_id_t &fn_id) {
+    switch (sampling_switch_.mode) {
+        case SamplingSwitch::Mode::NONE:
+            return true;
+
+        case SamplingSwitch::Mode::CALL:
+            if (stack.closure_count() != 0)
+                return false;
+            return top_level_call_count_++ % period_ == 0;
+
+        case SamplingSwitch::Mode::FUNCTION: {
+            std::uint64_t fn_hash = std::hash<fn_id_t>{}(fn_id);
+            fn_hash =
+                compute_hash(&fn_hash, sizeof(fn_hash), sampling_switch_.seed);
+            return fn_hash % period_ == 0;
+        }
+
+        case SamplingSwitch::Mode::TIME: {
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start_time_;
+            return std::fmod(elapsed.count(), sampling_switch_.period) <
+                   sampling_switch_.window;
+        }
+    }
+    return true;
+}
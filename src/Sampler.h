@@ -0,0 +1,71 @@
+#ifndef PROMISEDYNTRACER_SAMPLER_H
+#define PROMISEDYNTRACER_SAMPLER_H
+
+#include "SamplingSwitch.h"
+#include "State.h"
+#include <chrono>
+
+/* Decides which events reach the sampled analyses and the trace.
+
+   Sampling works at the granularity of closure calls. A call is either
+   sampled, and then everything that happens until it returns is sampled,
+   or it is not and then nested calls may start sampling on their own.
+   Each frame of full_stack remembers whether it was sampled, so that the
+   state is restored as the stack unwinds. Events outside of any call are
+   only sampled when sampling is off.
+
+   - CALL samples every period-th top level closure call, one without any
+     closure call below it on stack. Builtin and special calls do not count,
+     so the calls made under { or lapply are still top level.
+   - FUNCTION samples all calls to the functions whose seeded hash of fn_id
+     is a multiple of period.
+   - TIME samples the calls that start within the first window seconds of
+     every period seconds. */
+class Sampler {
+  public:
+    explicit Sampler(const SamplingSwitch &sampling_switch)
+        : sampling_switch_{sampling_switch},
+          top_level_sampled_{sampling_switch.mode ==
+                             SamplingSwitch::Mode::NONE},
+          sampled_{top_level_sampled_}, top_level_call_count_{0},
+          period_{static_cast<std::uint64_t>(sampling_switch.period)},
+          start_time_{std::chrono::steady_clock::now()} {
+        if (period_ == 0) {
+            period_ = 1;
+        }
+    }
+
+    const SamplingSwitch &get_sampling_switch() const {
+        return sampling_switch_;
+    }
+
+    bool is_sampled() const { return sampled_; }
+
+    /* Called before pushing the frame of a closure call on stack. Returns
+       whether the call is sampled, to be stored in its frame. */
+    bool enter_closure(const ExecutionStack &stack,
+                       const fn_id_t &fn_id) {
+        if (!sampled_) {
+            sampled_ = sample_closure_(stack, fn_id);
+        }
+        return sampled_;
+    }
+
+    /* Called after popping frames off stack. */
+    void restore(const ExecutionStack &stack) {
+        sampled_ = stack.empty() ? top_level_sampled_ : stack.back().sampled;
+    }
+
+  private:
+    bool sample_closure_(const ExecutionStack &stack,
+                         const fn_id_t &fn_id);
+
+    const SamplingSwitch sampling_switch_;
+    const bool top_level_sampled_;
+    bool sampled_;
+    std::uint64_t top_level_call_count_;
+    std::uint64_t period_;
+    const std::chrono::steady_clock::time_point start_time_;
+};
+
+#endif /* PROMISEDYNTRACER_SAMPLER_H */
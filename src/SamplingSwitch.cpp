@@ -0,0 +1,45 @@
+#include "SamplingSwitch.h"
+
+double SamplingSwitch::get_rate() const {
+    switch (mode) {
+        case Mode::NONE:
+            return 1;
+        case Mode::CALL:
+        case Mode::FUNCTION:
+            return 1 / period;
+        case Mode::TIME:
+            return window / period;
+    }
+    return 1;
+}
+
+std::string sampling_mode_to_string(SamplingSwitch::Mode mode) {
+    switch (mode) {
+        case SamplingSwitch::Mode::NONE:
+            return "none";
+        case SamplingSwitch::Mode::CALL:
+            return "call";
+        case SamplingSwitch::Mode::FUNCTION:
+            return "function";
+        case SamplingSwitch::Mode::TIME:
+            return "time";
+    }
+    return "unknown";
+}
+
+std::ostream &operator<<(std::ostream &os,
+                         const SamplingSwitch &sampling_switch) {
+    os << std::endl
+       << "Sampling Mode                   : "
+       << sampling_mode_to_string(sampling_switch.mode) << std::endl
+       << "Sampling Period                 : " << sampling_switch.period
+       << std::endl
+       << "Sampling Window                 : " << sampling_switch.window
+       << std::endl
+       << "Sampling Seed                   : " << sampling_switch.seed
+       << std::endl
+       << "Sampling Rate                   : " << sampling_switch.get_rate()
+       << std::endl;
+
+    return os;
+}
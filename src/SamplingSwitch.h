@@ -0,0 +1,33 @@
+#ifndef PROMISEDYNTRACER_SAMPLING_SWITCH_H
+#define PROMISEDYNTRACER_SAMPLING_SWITCH_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+class SamplingSwitch {
+  public:
+    enum class Mode { NONE, CALL, FUNCTION, TIME };
+
+    Mode mode;
+    /* CALL: one in period top level calls is sampled.
+       FUNCTION: one in period functions is sampled.
+       TIME: length of a sampling period in seconds. */
+    double period;
+    /* TIME: seconds at the start of each period during which calls are
+       sampled, more than 0 and at most period. */
+    double window;
+    /* FUNCTION: seed of the hash selecting the sampled functions. */
+    std::uint64_t seed;
+
+    /* fraction of the calls or time that is sampled, counts in the output
+       are extrapolated by dividing them by the rate. */
+    double get_rate() const;
+
+    friend std::ostream &operator<<(std::ostream &os,
+                                    const SamplingSwitch &sampling_switch);
+};
+
+std::string sampling_mode_to_string(SamplingSwitch::Mode mode);
+
+#endif /* PROMISEDYNTRACER_SAMPLING_SWITCH_H */
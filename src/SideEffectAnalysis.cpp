@@ -4,13 +4,17 @@ const int SideEffectAnalysis::PROMISE = 0;
 const int SideEffectAnalysis::FUNCTION = 0;
 const int SideEffectAnalysis::GLOBAL = 0;
 
+const probe_groups_t SideEffectAnalysis::PROBE_GROUPS =
+    PROBES_ENVIRONMENT_VARIABLE;
+
 const std::vector<std::string> SideEffectAnalysis::scopes{"promise", "function",
                                                           "global"};
 
 SideEffectAnalysis::SideEffectAnalysis(tracer_state_t &tracer_state,
                                        const std::string &output_dir,
                                        bool truncate, bool binary,
-                                       int compression_level)
+                                       int compression_level,
+                                       int compression_threads)
     : tracer_state_(tracer_state), output_dir_(output_dir),
       defines_{std::vector<long long int>(3)},
       assigns_{std::vector<long long int>(3)},
@@ -19,10 +23,11 @@ SideEffectAnalysis::SideEffectAnalysis(tracer_state_t &tracer_state,
       undefined_timestamp{std::numeric_limits<std::size_t>::max()},
       observed_side_effects_data_table_{create_data_table(
           output_dir + "/" + "observed-side-effects", {"scope", "count"},
-          truncate, binary, compression_level)},
+          truncate, binary, compression_level, compression_threads)},
       caused_side_effects_data_table_{create_data_table(
           output_dir + "/" + "caused-side-effects",
-          {"scope", "action", "count"}, truncate, binary, compression_level)} {}
+          {"scope", "action", "count"}, truncate, binary, compression_level,
+          compression_threads)} {}
 
 void SideEffectAnalysis::promise_created(
     const prom_basic_info_t &prom_basic_info, const SEXP promise) {
@@ -67,19 +72,18 @@ void SideEffectAnalysis::environment_lookup_var(const SEXP symbol,
     if (variable_timestamp == undefined_timestamp)
         return;
 
-    size_t stack_size = tracer_state_.full_stack.size();
+    const ExecutionStack &stack = tracer_state_.full_stack;
 
-    for (int i = stack_size - 1; i >= 0; --i) {
-        stack_event_t exec_context = tracer_state_.full_stack[i];
+    for (int i = stack.last_index(stack_type::PROMISE); i >= 0;
+         i = stack.previous_index(i, stack_type::PROMISE)) {
+        const stack_event_t &exec_context = stack[i];
 
-        if (exec_context.type == stack_type::PROMISE) {
-            timestamp_t promise_timestamp{
-                get_promise_timestamp_(exec_context.promise_id)};
+        timestamp_t promise_timestamp{
+            get_promise_timestamp_(exec_context.promise_id)};
 
-            if (promise_timestamp != undefined_timestamp) {
-                if (promise_timestamp < variable_timestamp) {
-                    side_effect_observers_.insert(exec_context.promise_id);
-                }
+        if (promise_timestamp != undefined_timestamp) {
+            if (promise_timestamp < variable_timestamp) {
+                side_effect_observers_.insert(exec_context.promise_id);
             }
         }
     }
@@ -87,25 +91,23 @@ void SideEffectAnalysis::environment_lookup_var(const SEXP symbol,
 
 void SideEffectAnalysis::environment_action(
     const SEXP rho, std::vector<long long int> &counter) {
-    size_t stack_size = tracer_state_.full_stack.size();
-    for (int i = stack_size - 1; i >= 0; --i) {
-        stack_event_t exec_context = tracer_state_.full_stack[i];
-        if (exec_context.type == stack_type::CALL) {
-            SEXP enclosing_address =
-                reinterpret_cast<SEXP>(exec_context.enclosing_environment);
-            // function side effects matter iff they are done in external
-            // environments.
-            if (rho != enclosing_address)
-                ++counter[SideEffectAnalysis::FUNCTION];
-            return;
-        } else if (exec_context.type == stack_type::PROMISE) {
-
-            ++counter[SideEffectAnalysis::PROMISE];
-            return;
-        }
+    const ExecutionStack &stack = tracer_state_.full_stack;
+    int call_index = stack.last_index(stack_type::CALL);
+    int promise_index = stack.last_index(stack_type::PROMISE);
+
+    if (promise_index > call_index) {
+        ++counter[SideEffectAnalysis::PROMISE];
+    } else if (call_index >= 0) {
+        SEXP enclosing_address =
+            reinterpret_cast<SEXP>(stack[call_index].enclosing_environment);
+        // function side effects matter iff they are done in external
+        // environments.
+        if (rho != enclosing_address)
+            ++counter[SideEffectAnalysis::FUNCTION];
+    } else {
+        /* empty stack implies that the action happens at top level */
+        ++counter[SideEffectAnalysis::GLOBAL];
     }
-    /* empty stack implies that the action happens at top level */
-    ++counter[SideEffectAnalysis::GLOBAL];
 }
 
 void SideEffectAnalysis::end(dyntracer_t *dyntracer) { serialize(); }
@@ -1,6 +1,7 @@
 #ifndef __SIDE_EFFECT_ANALYSIS_H__
 #define __SIDE_EFFECT_ANALYSIS_H__
 
+#include "Analysis.h"
 #include "CallState.h"
 #include "FunctionState.h"
 #include "PromiseState.h"
@@ -13,16 +14,18 @@
 
 typedef std::size_t timestamp_t;
 
-class SideEffectAnalysis {
+class SideEffectAnalysis : public Analysis {
   public:
     const static int PROMISE;
     const static int FUNCTION;
     const static int GLOBAL;
     const static std::vector<std::string> scopes;
+    static const probe_groups_t PROBE_GROUPS;
 
     SideEffectAnalysis(tracer_state_t &tracer_state,
                        const std::string &output_dir, bool truncate,
-                       bool binary, int compression_level);
+                       bool binary, int compression_level,
+                       int compression_threads);
 
     void promise_created(const prom_basic_info_t &prom_basic_info,
                          const SEXP promise);
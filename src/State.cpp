@@ -5,12 +5,20 @@
 void tracer_state_t::finish_pass() { promise_origin.clear(); }
 
 tracer_state_t::tracer_state_t() {
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+    /* sessions tag the ids stored in promises with 16 bits, never 0 */
+    static std::uint64_t promise_id_session_counter = 0;
+    promise_id_session = promise_id_session_counter++ % 0xFFFF + 1;
+#endif
     call_id_counter = 0;
     fn_id_counter = 0;
     prom_id_counter = 0;
     prom_neg_id_counter = 0;
     argument_id_sequence = 0;
     gc_trigger_counter = 0;
+#ifdef DYNTRACE_COUNT_EVENTS
+    event_counter = 0;
+#endif
     environment_id_counter = 0;
     variable_id_counter = 0;
 }
@@ -22,42 +30,50 @@ int tracer_state_t::get_gc_trigger_counter() const {
 }
 
 void tracer_state_t::remove_environment(const SEXP rho) {
-    environments.erase(rho);
+    auto iter = environments.find(rho);
+    if (iter == environments.end()) {
+        return;
+    }
+    for (SEXP symbol : iter->second.symbols) {
+        variables.erase({iter->second.id, symbol});
+    }
+    environments.erase(iter);
 }
 
-env_id_t tracer_state_t::to_environment_id(SEXP rho) {
-    const auto &iter = environments.find(rho);
-    if (iter == environments.end()) {
-        env_id_t environment_id = environment_id_counter++;
-        environments[rho] =
-            std::pair<env_id_t, unordered_map<string, var_id_t>>(environment_id,
-                                                                 {});
-        return environment_id;
-    } else {
-        return (iter->second).first;
+/* an environment allocated at the address of one that has been collected
+   without being unmarked must not inherit its variables */
+env_id_t tracer_state_t::create_environment(SEXP rho) {
+    remove_environment(rho);
+    env_id_t environment_id = environment_id_counter++;
+    environments.try_emplace(rho, environment_id, vector<SEXP>());
+    return environment_id;
+}
+
+environment_t &tracer_state_t::get_environment(SEXP rho) {
+    const auto &result =
+        environments.try_emplace(rho, environment_id_counter, vector<SEXP>());
+    if (result.second) {
+        ++environment_id_counter;
     }
+    return result.first->second;
 }
 
-var_id_t tracer_state_t::to_variable_id(SEXP symbol, SEXP rho, bool &exists) {
-    return to_variable_id(CHAR(PRINTNAME(symbol)), rho, exists);
+env_id_t tracer_state_t::to_environment_id(SEXP rho) {
+    return get_environment(rho).id;
 }
 
-var_id_t tracer_state_t::to_variable_id(const std::string &symbol, SEXP rho,
-                                        bool &exists) {
-    to_environment_id(rho);
-    var_id_t variable_id;
-    const auto &iter{environments.find(rho)};
-    auto &variables = (iter->second).second;
-    const auto &iter2 = variables.find(symbol);
-    if (iter2 == variables.end()) {
-        exists = false;
-        variable_id = variable_id_counter++;
-        variables[symbol] = variable_id;
-    } else {
-        exists = true;
-        variable_id = iter2->second;
+/* The symbol name is not looked at, it is only needed by the caller when
+   the variable is serialized for the first time. */
+var_id_t tracer_state_t::to_variable_id(SEXP symbol, SEXP rho, bool &exists) {
+    environment_t &environment = get_environment(rho);
+    const auto &result =
+        variables.try_emplace({environment.id, symbol}, variable_id_counter);
+    exists = !result.second;
+    if (result.second) {
+        ++variable_id_counter;
+        environment.symbols.push_back(symbol);
     }
-    return variable_id;
+    return result.first->second;
 }
 
 // This function returns -1 if we are not in an enclosing promise scope.
@@ -65,14 +81,8 @@ var_id_t tracer_state_t::to_variable_id(const std::string &symbol, SEXP rho,
 // process this information downstream.
 // TODO use a more general function to get stuff form stack by type
 prom_id_t tracer_state_t::enclosing_promise_id() {
-
-    for (std::vector<stack_event_t>::reverse_iterator iterator =
-             full_stack.rbegin();
-         iterator != full_stack.rend(); ++iterator) {
-        if (iterator->type == stack_type::PROMISE)
-            return iterator->promise_id;
-    }
-    return -1;
+    int index = full_stack.last_index(stack_type::PROMISE);
+    return index < 0 ? -1 : full_stack[index].promise_id;
 }
 
 static stack_event_t make_dummy_stack_event() {
@@ -80,31 +90,22 @@ static stack_event_t make_dummy_stack_event() {
     dummy_event.type = stack_type::NONE;
     dummy_event.enclosing_environment = 0;
     dummy_event.context_id = 0;
+    dummy_event.sampled = false;
     return dummy_event;
 }
 
 // TODO return pointer?
-stack_event_t get_last_on_stack_by_type(vector<stack_event_t> &stack,
+stack_event_t get_last_on_stack_by_type(const ExecutionStack &stack,
                                         stack_type type) {
-    for (vector<stack_event_t>::reverse_iterator i = stack.rbegin();
-         i != stack.rend(); ++i)
-        if (type == i->type)
-            return *i;
-
-    return make_dummy_stack_event();
+    int index = stack.last_index(type);
+    return index < 0 ? make_dummy_stack_event() : stack[index];
 }
 
-stack_event_t get_from_back_of_stack_by_type(vector<stack_event_t> &stack,
+stack_event_t get_from_back_of_stack_by_type(const ExecutionStack &stack,
                                              stack_type type, int rposition) {
-    int rindex = rposition;
-    for (vector<stack_event_t>::reverse_iterator i = stack.rbegin();
-         i != stack.rend(); ++i)
-        if (type == i->type) {
-            if (rindex == 0)
-                return *i;
-            else
-                rindex--;
-        }
+    int index = stack.last_index(type);
+    for (; index >= 0 && rposition > 0; --rposition)
+        index = stack.previous_index(index, type);
 
-    return make_dummy_stack_event();
+    return index < 0 ? make_dummy_stack_event() : stack[index];
 }
@@ -1,8 +1,10 @@
 #ifndef PROMISEDYNTRACER_STATE_H
 #define PROMISEDYNTRACER_STATE_H
 
+#include "FlatHashMap.h"
 #include "sexptypes.h"
 #include "stdlibs.h"
+#include <array>
 
 using std::get;
 using std::hash;
@@ -31,7 +33,19 @@ typedef rsid_t prom_id_t;
 typedef rid_t
     call_id_t; // integer TODO this is pedantic, but shouldn't this be int?
 
-typedef string fn_id_t;  // integer
+/* Functions are identified by a 64 bit hash of their definition which is
+   only turned into a string by fn_id_to_string when written out. Building
+   with DYNTRACE_LEGACY_FUNCTION_IDS brings back the base64 encoded MD5
+   strings of older traces. */
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
+typedef string fn_id_t;
+#else
+typedef std::uint64_t fn_id_t;
+#endif
+/* Index of a function id in tracer_state_t::function_ids, in order of first
+   occurrence. Stack frames hold it rather than the fn_id_t, so that they
+   stay plain integers with DYNTRACE_LEGACY_FUNCTION_IDS too. */
+typedef std::uint32_t fn_index_t;
 typedef rid_t fn_addr_t; // hexadecimal
 typedef string fn_key_t; // pun
 typedef int env_id_t;
@@ -55,6 +69,7 @@ enum class parameter_mode_t {
 struct arg_t {
     arg_id_t id;
     string name;
+    SEXP symbol; // R_NilValue for unnamed arguments
     sexptype_t expression_type;
     sexptype_t name_type;
     prom_id_t promise_id; // only set if sexptype_t == PROM
@@ -63,7 +78,7 @@ struct arg_t {
     int formal_parameter_position;
 };
 
-enum class function_type {
+enum class function_type : std::uint8_t {
     CLOSURE = 0,
     BUILTIN = 1,
     SPECIAL = 2,
@@ -86,10 +101,17 @@ enum class lifestyle_type {
     IMMEDIATE_BRANCH_LOCAL = 5
 };
 
-enum class stack_type { PROMISE = 1, CALL = 2, CONTEXT = 3, NONE = 0 };
+enum class stack_type : std::uint8_t {
+    PROMISE = 1,
+    CALL = 2,
+    CONTEXT = 3,
+    NONE = 0
+};
 
+/* Frames are pushed, popped and copied by value on every call, promise and
+   context event. They only hold integers, so that this is a plain copy of
+   24 bytes, and the small fields are packed at the end. */
 struct stack_event_t {
-    stack_type type;
     union {
         prom_id_t promise_id;
         call_id_t call_id;
@@ -97,10 +119,95 @@ struct stack_event_t {
     };
     env_addr_t enclosing_environment;
     // Only initialized for type == CALL
-    struct {
-        fn_id_t function_id;
-        function_type type;
-    } function_info;
+    fn_index_t function_index;
+    stack_type type;
+    // Only initialized for type == CALL
+    function_type fn_type;
+    /* whether events are sampled while this is on stack */
+    bool sampled;
+};
+
+static_assert(std::is_trivially_copyable<stack_event_t>::value,
+              "stack_event_t is copied on every stack operation");
+static_assert(sizeof(stack_event_t) <= 24,
+              "stack_event_t is copied on every stack operation");
+
+/* The tracer's stack of calls, promises and contexts. Each frame links to
+   the closest frame of every type below it, so the closest frame of a type
+   is found without scanning the frames in between. Frames are only read
+   through the stack, the links depend on their types not changing. */
+class ExecutionStack {
+  public:
+    typedef vector<stack_event_t>::const_iterator const_iterator;
+    typedef vector<stack_event_t>::const_reverse_iterator
+        const_reverse_iterator;
+
+    ExecutionStack() : closure_count_{0} { top_.fill(-1); }
+
+    bool empty() const { return frames_.empty(); }
+
+    std::size_t size() const { return frames_.size(); }
+
+    const stack_event_t &operator[](std::size_t index) const {
+        return frames_[index];
+    }
+
+    const stack_event_t &back() const { return frames_.back(); }
+
+    const_iterator begin() const { return frames_.begin(); }
+    const_iterator end() const { return frames_.end(); }
+    const_reverse_iterator rbegin() const { return frames_.rbegin(); }
+    const_reverse_iterator rend() const { return frames_.rend(); }
+
+    void push_back(const stack_event_t &event) {
+        links_.push_back(top_);
+        top_[static_cast<std::size_t>(event.type)] =
+            static_cast<int>(frames_.size());
+        frames_.push_back(event);
+        closure_count_ += is_closure_(event);
+    }
+
+    void pop_back() {
+        closure_count_ -= is_closure_(frames_.back());
+        top_ = links_.back();
+        links_.pop_back();
+        frames_.pop_back();
+    }
+
+    void clear() {
+        frames_.clear();
+        links_.clear();
+        top_.fill(-1);
+        closure_count_ = 0;
+    }
+
+    /* number of closure calls on stack, builtin and special calls left out */
+    std::size_t closure_count() const { return closure_count_; }
+
+    /* index of the closest frame of this type, -1 if there is none */
+    int last_index(stack_type type) const {
+        return top_[static_cast<std::size_t>(type)];
+    }
+
+    /* index of the closest frame of this type below the frame at index, -1
+       if there is none */
+    int previous_index(int index, stack_type type) const {
+        return links_[index][static_cast<std::size_t>(type)];
+    }
+
+  private:
+    /* indexed by stack_type */
+    typedef std::array<int, 4> links_t;
+
+    static bool is_closure_(const stack_event_t &event) {
+        return event.type == stack_type::CALL &&
+               event.fn_type == function_type::CLOSURE;
+    }
+
+    vector<stack_event_t> frames_;
+    vector<links_t> links_;
+    links_t top_;
+    std::size_t closure_count_;
 };
 
 typedef map<std::string, std::string> metadata_t;
@@ -117,12 +224,42 @@ struct context_t {
     env_addr_t environment;
 };
 
+struct function_t {
+    fn_id_t fn_id;
+    fn_index_t fn_index;
+    string definition;
+};
+
 // typedef pair<prom_id_t, call_id_t> prom_stack_elem_t;
 typedef prom_addr_t prom_key_t;
 
+/* Optional fields of call_info_t. They are costly to compute, so the
+   recorder only fills in the ones requested by an enabled consumer. */
+typedef unsigned int call_info_fields_t;
+const call_info_fields_t CALL_INFO_NAME = 1 << 0;
+const call_info_fields_t CALL_INFO_DEFINITION = 1 << 1;
+const call_info_fields_t CALL_INFO_LOCATION = 1 << 2;
+const call_info_fields_t CALL_INFO_EXPRESSION = 1 << 3;
+const call_info_fields_t CALL_INFO_ALL =
+    CALL_INFO_NAME | CALL_INFO_DEFINITION | CALL_INFO_LOCATION |
+    CALL_INFO_EXPRESSION;
+
+/* Optional groups of probes. The tracer only attaches the ones requested by
+   an enabled consumer, the others are left NULL and never fire. */
+typedef unsigned int probe_groups_t;
+/* promise_{value,expression,environment}_{lookup,assign} */
+const probe_groups_t PROBES_PROMISE_SLOT = 1 << 0;
+/* environment_variable_{define,assign,remove,lookup} */
+const probe_groups_t PROBES_ENVIRONMENT_VARIABLE = 1 << 1;
+/* gc_entry and gc_exit */
+const probe_groups_t PROBES_GC = 1 << 2;
+const probe_groups_t PROBES_ALL =
+    PROBES_PROMISE_SLOT | PROBES_ENVIRONMENT_VARIABLE | PROBES_GC;
+
 struct call_info_t {
     function_type fn_type;
     fn_id_t fn_id;
+    fn_index_t fn_index;
     SEXP fn_addr; // TODO unnecessary?
     string fn_definition;
     string definition_location;
@@ -187,14 +324,34 @@ struct type_gc_info_t {
     long bytes;
 };
 
+/* Promise ids are kept in promise_ids by promise address. Building with
+   DYNTRACE_PROMISE_ID_FIELD against an R-dyntrace whose PROMSXP has a spare
+   id field, read and written by DYNTRACE_PROMISE_ID and
+   SET_DYNTRACE_PROMISE_ID, stores them in the promise itself instead, which
+   saves a table lookup on every promise event. */
 prom_id_t get_promise_id(dyntracer_t *dyntracer, SEXP promise);
 prom_id_t make_promise_id(dyntracer_t *dyntracer, SEXP promise,
                           bool negative = false);
 call_id_t make_funcall_id(dyntracer_t *dyntracer, SEXP);
-string get_function_definition(dyntracer_t *dyntracer, const SEXP function);
-void remove_function_definition(dyntracer_t *dyntracer, const SEXP function);
+const function_t &get_function(dyntracer_t *dyntracer, const SEXP function);
+void remove_function(dyntracer_t *dyntracer, const SEXP function);
+fn_index_t get_function_index(dyntracer_t *dyntracer, const string &def);
 fn_id_t get_function_id(dyntracer_t *dyntracer, const string &def,
                         bool builtin = false);
+string fn_id_to_string(std::uint64_t fn_id);
+inline const string &fn_id_to_string(const string &fn_id) { return fn_id; }
+
+/* Function id field of a trace record. The serializer only renders it with
+   fn_id_to_string once it knows that the record is written. */
+struct fn_id_field_t {
+    const fn_id_t &fn_id;
+};
+
+/* Symbol name field of a trace record. R never collects symbols, so the
+   binary encoding interns the name by the address of its PRINTNAME. */
+struct symbol_field_t {
+    SEXP symbol;
+};
 fn_addr_t get_function_addr(SEXP func);
 
 // Returns false if function already existed, true if it was registered now
@@ -203,7 +360,7 @@ bool register_inserted_function(dyntracer_t *dyntracer, fn_id_t id);
 bool function_already_inserted(fn_id_t id);
 bool negative_promise_already_inserted(dyntracer_t *dyntracer, prom_id_t id);
 template <typename T>
-void get_stack_parent(T &info, vector<stack_event_t> &stack) {
+void get_stack_parent(T &info, const ExecutionStack &stack) {
     // put the body here
     static_assert(std::is_base_of<prom_basic_info_t, T>::value ||
                       std::is_base_of<prom_info_t, T>::value ||
@@ -232,7 +389,7 @@ void get_stack_parent(T &info, vector<stack_event_t> &stack) {
 }
 
 template <typename T>
-void get_stack_parent2(T &info, vector<stack_event_t> &stack) {
+void get_stack_parent2(T &info, const ExecutionStack &stack) {
     // put the body here
     static_assert(std::is_base_of<prom_basic_info_t, T>::value ||
                       std::is_base_of<prom_info_t, T>::value ||
@@ -259,9 +416,9 @@ void get_stack_parent2(T &info, vector<stack_event_t> &stack) {
     }
 }
 
-stack_event_t get_last_on_stack_by_type(vector<stack_event_t> &stack,
+stack_event_t get_last_on_stack_by_type(const ExecutionStack &stack,
                                         stack_type type);
-stack_event_t get_from_back_of_stack_by_type(vector<stack_event_t> &stack,
+stack_event_t get_from_back_of_stack_by_type(const ExecutionStack &stack,
                                              stack_type type, int rposition);
 
 prom_id_t get_parent_promise(dyntracer_t *dyntracer);
@@ -278,15 +435,50 @@ size_t get_no_of_ancestor_calls_on_stack();
 
 string recursive_type_to_string(recursion_type);
 
+/* R interns symbols and never collects them, so a variable is identified by
+   the address of its symbol and the id of its environment. */
+struct variable_key_t {
+    env_id_t environment_id;
+    SEXP symbol;
+
+    bool operator==(const variable_key_t &other) const {
+        return environment_id == other.environment_id &&
+               symbol == other.symbol;
+    }
+};
+
+struct variable_key_hash_t {
+    std::size_t operator()(const variable_key_t &key) const {
+        return reinterpret_cast<std::uintptr_t>(key.symbol) ^
+               (static_cast<std::size_t>(key.environment_id) << 32);
+    }
+};
+
+struct environment_t {
+    env_id_t id;
+    // symbols of the variables seen in this environment, so that they can
+    // be dropped from the variable table along with the environment
+    vector<SEXP> symbols;
+};
+
 struct tracer_state_t {
-    vector<stack_event_t> full_stack; // Should be reset on each tracer pass
+    ExecutionStack full_stack; // Should be reset on each tracer pass
+    // Arguments captured on entry to each closure on full_stack, innermost
+    // last. They are handed back to the exit probe instead of recomputed.
+    vector<arglist_t> closure_arguments;
 
+    // The tables below are consulted by almost every probe, they are flat
+    // so that a lookup touches one or two cache lines.
     // Map from promise IDs to call IDs
-    unordered_map<prom_id_t, call_id_t>
+    FlatHashMap<prom_id_t, call_id_t>
         promise_origin; // Should be reset on each tracer pass
-    unordered_set<prom_id_t> fresh_promises;
+    FlatHashSet<prom_id_t> fresh_promises;
     // Map from promise address to promise ID;
-    unordered_map<prom_addr_t, prom_id_t> promise_ids;
+    FlatHashMap<prom_addr_t, prom_id_t> promise_ids;
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+    // Tags the ids stored in promises by this tracer
+    std::uint64_t promise_id_session;
+#endif
     unordered_map<prom_id_t, int> promise_lookup_gc_trigger_counter;
     env_id_t environment_id_counter;
     var_id_t variable_id_counter;
@@ -301,11 +493,12 @@ struct tracer_state_t {
                                // true)
     prom_id_t prom_neg_id_counter;
 
-    unordered_map<SEXP, string> function_definitions;
+    FlatHashMap<SEXP, function_t> functions;
 
-    unordered_map<fn_key_t, fn_id_t> function_ids; // Should be kept across Rdt
-                                                   // calls (unless overwrite is
-                                                   // true)
+    FlatHashMap<fn_key_t, fn_index_t>
+        function_indices; // Should be kept across Rdt calls (unless
+                          // overwrite is true)
+    vector<fn_id_t> function_ids; // indexed by fn_index_t
     unordered_set<fn_id_t> already_inserted_functions; // Should be kept across
                                                        // Rdt calls (unless
                                                        // overwrite is true)
@@ -317,18 +510,20 @@ struct tracer_state_t {
                                             // true)
     arg_id_t argument_id_sequence; // Should be globally unique (can reset
                                    // between tracer calls if overwrite is true)
-    map<arg_key_t, arg_id_t> argument_ids; // Should be kept across Rdt calls
-                                           // (unless overwrite is true)
     int gc_trigger_counter; // Incremented each time there is a gc_entry
+#ifdef DYNTRACE_COUNT_EVENTS
+    // Incremented by every attached probe, written to EVENTS on exit
+    std::uint64_t event_counter;
+#endif
 
-    std::unordered_map<
-        SEXP, std::pair<env_id_t, std::unordered_map<std::string, var_id_t>>>
-        environments;
+    FlatHashMap<SEXP, environment_t> environments;
+    FlatHashMap<variable_key_t, var_id_t, variable_key_hash_t> variables;
 
     void finish_pass();
+    env_id_t create_environment(SEXP rho);
+    environment_t &get_environment(SEXP rho);
     env_id_t to_environment_id(SEXP rho);
     var_id_t to_variable_id(SEXP symbol, SEXP rho, bool &exists);
-    var_id_t to_variable_id(const std::string &symbol, SEXP rho, bool &exists);
     prom_id_t enclosing_promise_id();
     void remove_environment(const SEXP rho);
     void increment_gc_trigger_counter();
@@ -0,0 +1,345 @@
+#ifndef PROMISEDYNTRACER_STATIC_ANALYSIS_DRIVER_H
+#define PROMISEDYNTRACER_STATIC_ANALYSIS_DRIVER_H
+
+#include "AnalysisDriver.h"
+#include "Timer.h"
+#include <tuple>
+#include <utility>
+
+/* Runs Analyses in list order on every event. Dispatch to each analysis is
+   resolved at compile time, so events an analysis does not handle cost
+   nothing and analyses left out of the list are never constructed.
+
+   The first analysis sees gc_promise_unmarked and end after all others, as
+   the ones listed after it can depend on it (PromiseMapper).
+
+   Analyses with SAMPLED set only see the events of sampled calls, except
+   gc_promise_unmarked, context_jump and end which they always see so that
+   they can release their state. The probes only pass sampled frames to
+   context_jump.
+
+   With RUNTIME_SWITCH, only the analyses turned on by the analysis switch
+   are constructed and each dispatch checks for their presence. This is the
+   fallback for combinations that are not instantiated ahead of time. */
+#ifdef DYNTRACE_ENABLE_TIMING
+
+/* segment of the analyses timer that sums the time spent in T */
+template <typename T> struct analysis_timer_segment;
+
+#define ANALYSIS_TIMER_SEGMENT(ANALYSIS, SEGMENT)                              \
+    template <> struct analysis_timer_segment<ANALYSIS> {                      \
+        static const TimerSegment value = TimerSegment::SEGMENT;               \
+    };
+
+ANALYSIS_TIMER_SEGMENT(PromiseMapper, PROMISE_MAPPER)
+ANALYSIS_TIMER_SEGMENT(ObjectCountSizeAnalysis, OBJECT_COUNT_SIZE_ANALYSIS)
+ANALYSIS_TIMER_SEGMENT(PromiseTypeAnalysis, PROMISE_TYPE_ANALYSIS)
+ANALYSIS_TIMER_SEGMENT(PromiseEvaluationAnalysis, PROMISE_EVALUATION_ANALYSIS)
+ANALYSIS_TIMER_SEGMENT(StrictnessAnalysis, STRICTNESS_ANALYSIS)
+ANALYSIS_TIMER_SEGMENT(SideEffectAnalysis, SIDE_EFFECT_ANALYSIS)
+
+#undef ANALYSIS_TIMER_SEGMENT
+
+#endif /* DYNTRACE_ENABLE_TIMING */
+
+template <bool RUNTIME_SWITCH, typename... Analyses>
+class StaticAnalysisDriver final : public AnalysisDriver {
+  public:
+    StaticAnalysisDriver(tracer_state_t &tracer_state, const Sampler &sampler,
+                         const std::string &output_dir, bool truncate,
+                         bool binary, int compression_level,
+                         int compression_threads,
+                         const AnalysisSwitch analysis_switch)
+        : AnalysisDriver(tracer_state, sampler, output_dir, truncate, binary,
+                         compression_level, compression_threads,
+                         analysis_switch) {
+        std::apply(
+            [this](auto &... analysis) {
+                (create_(analysis, RUNTIME_SWITCH), ...);
+            },
+            analyses_);
+    }
+
+    ~StaticAnalysisDriver() {
+        destroy_(std::index_sequence_for<Analyses...>{});
+    }
+
+    call_info_fields_t get_call_info_fields() const override {
+        call_info_fields_t fields = 0;
+        std::apply(
+            [&fields](const auto &... analysis) {
+                ((fields |= get_call_info_fields_(analysis)), ...);
+            },
+            analyses_);
+        return fields;
+    }
+
+    probe_groups_t get_probe_groups() const override {
+        probe_groups_t groups = 0;
+        std::apply(
+            [&groups](const auto &... analysis) {
+                ((groups |= get_probe_groups_(analysis)), ...);
+            },
+            analyses_);
+        return groups;
+    }
+
+    void closure_entry(const closure_info_t &closure_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.closure_entry(closure_info);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(FUNCTION_ENTRY_ANALYSIS);
+    }
+
+    void closure_exit(const closure_info_t &closure_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) { analysis.closure_exit(closure_info); });
+        ANALYSIS_TIMER_END_SEGMENT(FUNCTION_EXIT_ANALYSIS);
+    }
+
+    void special_entry(const builtin_info_t &special_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.special_entry(special_info);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(BUILTIN_ENTRY_ANALYSIS);
+    }
+
+    void special_exit(const builtin_info_t &special_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) { analysis.special_exit(special_info); });
+        ANALYSIS_TIMER_END_SEGMENT(BUILTIN_EXIT_ANALYSIS);
+    }
+
+    void builtin_entry(const builtin_info_t &builtin_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.builtin_entry(builtin_info);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(BUILTIN_ENTRY_ANALYSIS);
+    }
+
+    void builtin_exit(const builtin_info_t &builtin_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) { analysis.builtin_exit(builtin_info); });
+        ANALYSIS_TIMER_END_SEGMENT(BUILTIN_EXIT_ANALYSIS);
+    }
+
+    void promise_created(const prom_basic_info_t &prom_basic_info,
+                         const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_created(prom_basic_info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(CREATE_PROMISE_ANALYSIS);
+    }
+
+    void promise_force_entry(const prom_info_t &prom_info,
+                             const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_force_entry(prom_info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(FORCE_PROMISE_ENTRY_ANALYSIS);
+    }
+
+    void promise_force_exit(const prom_info_t &prom_info,
+                            const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_force_exit(prom_info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(FORCE_PROMISE_EXIT_ANALYSIS);
+    }
+
+    void promise_environment_lookup(const prom_info_t &info,
+                                    const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_environment_lookup(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(LOOKUP_PROMISE_ENVIRONMENT_ANALYSIS);
+    }
+
+    void promise_expression_lookup(const prom_info_t &info,
+                                   const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_expression_lookup(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(LOOKUP_PROMISE_EXPRESSION_ANALYSIS);
+    }
+
+    void promise_value_lookup(const prom_info_t &info,
+                              const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_value_lookup(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(LOOKUP_PROMISE_VALUE_ANALYSIS);
+    }
+
+    void promise_environment_set(const prom_info_t &info,
+                                 const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_environment_set(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(SET_PROMISE_ENVIRONMENT_ANALYSIS);
+    }
+
+    void promise_expression_set(const prom_info_t &info,
+                                const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_expression_set(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(SET_PROMISE_EXPRESSION_ANALYSIS);
+    }
+
+    void promise_value_set(const prom_info_t &info,
+                           const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.promise_value_set(info, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(SET_PROMISE_VALUE_ANALYSIS);
+    }
+
+    void gc_promise_unmarked(const prom_id_t prom_id,
+                             const SEXP promise) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_first_last_([&](auto &analysis) {
+            analysis.gc_promise_unmarked(prom_id, promise);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(GC_PROMISE_UNMARKED_ANALYSIS);
+    }
+
+    void vector_alloc(const type_gc_info_t &type_gc_info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) { analysis.vector_alloc(type_gc_info); });
+        ANALYSIS_TIMER_END_SEGMENT(VECTOR_ALLOC_ANALYSIS);
+    }
+
+    void environment_define_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.environment_define_var(symbol, value, rho);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(ENVIRONMENT_ACTION_ANALYSIS);
+    }
+
+    void environment_assign_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.environment_assign_var(symbol, value, rho);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(ENVIRONMENT_ACTION_ANALYSIS);
+    }
+
+    void environment_lookup_var(const SEXP symbol, const SEXP value,
+                                const SEXP rho) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.environment_lookup_var(symbol, value, rho);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(ENVIRONMENT_ACTION_ANALYSIS);
+    }
+
+    void environment_remove_var(const SEXP symbol, const SEXP rho) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_([&](auto &analysis) {
+            analysis.environment_remove_var(symbol, rho);
+        });
+        ANALYSIS_TIMER_END_SEGMENT(ENVIRONMENT_ACTION_ANALYSIS);
+    }
+
+    void context_jump(const unwind_info_t &info) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_all_([&](auto &analysis) { analysis.context_jump(info); });
+        ANALYSIS_TIMER_END_SEGMENT(CONTEXT_JUMP_ANALYSIS);
+    }
+
+    void end(dyntracer_t *dyntracer) override {
+        ANALYSIS_TIMER_RESET();
+        dispatch_first_last_(
+            [&](auto &analysis) { analysis.end(dyntracer); });
+        ANALYSIS_TIMER_END_SEGMENT(END_ANALYSIS);
+    }
+
+  private:
+    template <typename T>
+    static call_info_fields_t
+    get_call_info_fields_(const std::unique_ptr<T> &analysis) {
+        return analysis ? T::CALL_INFO_FIELDS : 0;
+    }
+
+    template <typename T>
+    static probe_groups_t
+    get_probe_groups_(const std::unique_ptr<T> &analysis) {
+        return analysis ? T::PROBE_GROUPS : 0;
+    }
+
+    template <typename T, typename F>
+    static void invoke_(std::unique_ptr<T> &analysis, F &function) {
+        if constexpr (RUNTIME_SWITCH) {
+            if (!analysis)
+                return;
+        }
+        ANALYSES_TIMER_RESET();
+        function(*analysis);
+        ANALYSES_TIMER_END_SEGMENT(analysis_timer_segment<T>::value);
+    }
+
+    template <typename T, typename F>
+    void invoke_sampled_(std::unique_ptr<T> &analysis, F &function) {
+        if constexpr (T::SAMPLED) {
+            if (!is_sampled())
+                return;
+        }
+        invoke_(analysis, function);
+    }
+
+    /* dispatch an event of the current call, subject to sampling */
+    template <typename F> void dispatch_(F function) {
+        std::apply(
+            [this, &function](auto &... analysis) {
+                (invoke_sampled_(analysis, function), ...);
+            },
+            analyses_);
+    }
+
+    template <typename F> void dispatch_all_(F function) {
+        std::apply(
+            [&function](auto &... analysis) {
+                (invoke_(analysis, function), ...);
+            },
+            analyses_);
+    }
+
+    template <typename F> void dispatch_first_last_(F function) {
+        if constexpr (sizeof...(Analyses) != 0) {
+            dispatch_rest_(function, std::make_index_sequence<
+                                         sizeof...(Analyses) - 1>{});
+            invoke_(std::get<0>(analyses_), function);
+        }
+    }
+
+    template <typename F, std::size_t... I>
+    void dispatch_rest_(F &function, std::index_sequence<I...>) {
+        (invoke_(std::get<I + 1>(analyses_), function), ...);
+    }
+
+    /* in reverse order of construction, as later analyses can refer to
+       earlier ones */
+    template <std::size_t... I> void destroy_(std::index_sequence<I...>) {
+        (std::get<sizeof...(I) - 1 - I>(analyses_).reset(), ...);
+    }
+
+    std::tuple<std::unique_ptr<Analyses>...> analyses_;
+};
+
+#endif /* PROMISEDYNTRACER_STATIC_ANALYSIS_DRIVER_H */
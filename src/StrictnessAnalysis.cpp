@@ -2,11 +2,17 @@
 
 const size_t FUNCTION_MAPPING_BUCKET_SIZE = 20000;
 
+const call_info_fields_t StrictnessAnalysis::CALL_INFO_FIELDS =
+    CALL_INFO_NAME | CALL_INFO_DEFINITION;
+
+const probe_groups_t StrictnessAnalysis::PROBE_GROUPS = PROBES_PROMISE_SLOT;
+
 StrictnessAnalysis::StrictnessAnalysis(const tracer_state_t &tracer_state,
                                        PromiseMapper *const promise_mapper,
                                        const std::string &output_dir,
                                        bool truncate, bool binary,
-                                       int compression_level)
+                                       int compression_level,
+                                       int compression_threads)
     : tracer_state_(tracer_state), output_dir_(output_dir),
       promise_mapper_(promise_mapper),
       functions_(std::unordered_map<fn_id_t, FunctionState>(
@@ -20,18 +26,18 @@ StrictnessAnalysis::StrictnessAnalysis(const tracer_state_t &tracer_state,
         {"call_id", "function_id", "parameter_position", "argument_mode",
          "expression_type", "value_type", "escape", "force_count",
          "lookup_count", "metaprogram_count"},
-        truncate, binary, compression_level);
+        truncate, binary, compression_level, compression_threads);
 
     call_data_table_ = create_data_table(
         output_dir + "/" + "calls",
         {"call_id", "function_id", "function_type", "formal_parameter_count",
          "function_name", "return_value_type", "force_order",
          "intrinsic_force_order"},
-        truncate, binary, compression_level);
+        truncate, binary, compression_level, compression_threads);
 
     call_graph_data_table_ = create_data_table(
         output_dir + "/" + "call-graph", {"caller_id", "callee_id"}, truncate,
-        binary, compression_level);
+        binary, compression_level, compression_threads);
 }
 
 void StrictnessAnalysis::function_entry_(call_id_t call_id, fn_id_t fn_id,
@@ -47,14 +53,14 @@ void StrictnessAnalysis::function_entry_(call_id_t call_id, fn_id_t fn_id,
     write_function_body_(fn_id, definition);
 
     // add entry to call stack and call map
-    CallState *call_state{new CallState(call_id, fn_id, fn_type, name,
-                                        formal_parameter_count, order)};
+    CallState *call_state{call_state_pool_.create(
+        call_id, fn_id, fn_type, name, formal_parameter_count, order)};
     call_stack_.push_back(call_state);
     call_map_.insert({call_id, call_state});
 }
 
-CallState StrictnessAnalysis::function_exit_(call_id_t call_id,
-                                             sexptype_t return_value_type) {
+void StrictnessAnalysis::function_exit_(call_id_t call_id,
+                                        sexptype_t return_value_type) {
     CallState *call_state{call_stack_.back()};
     call_stack_.pop_back();
 
@@ -66,7 +72,39 @@ CallState StrictnessAnalysis::function_exit_(call_id_t call_id,
     call_state->set_return_value_type(return_value_type);
     call_state->make_inactive();
     serialize_call_(*call_state);
-    return *call_state;
+
+    if (!call_state->has_argument_promises()) {
+        release_call_(call_state);
+    }
+}
+
+void StrictnessAnalysis::add_argument_promise_(prom_id_t promise_id,
+                                               CallState *call_state) {
+    call_state->add_argument_promise();
+
+    auto result = argument_promises_.insert({promise_id, call_state});
+
+    /* the promise is passed on to another call, which receives its uses from
+       now on */
+    if (!result.second) {
+        CallState *previous_call_state = result.first->second;
+        result.first->second = call_state;
+        remove_argument_promise_(previous_call_state);
+    }
+}
+
+void StrictnessAnalysis::remove_argument_promise_(CallState *call_state) {
+    call_state->remove_argument_promise();
+
+    if (!call_state->is_active() && !call_state->has_argument_promises()) {
+        release_call_(call_state);
+    }
+}
+
+void StrictnessAnalysis::release_call_(CallState *call_state) {
+    serialize_arguments_(*call_state);
+    call_map_.erase(call_state->get_call_id());
+    call_state_pool_.destroy(call_state);
 }
 
 /* When we enter a function, push information about it on a custom call stack.
@@ -90,6 +128,11 @@ void StrictnessAnalysis::closure_entry(const closure_info_t &closure_info) {
         call_stack_.back()->set_parameter_mode(
             argument.formal_parameter_position, argument.parameter_mode);
 
+        if (argument.parameter_mode == parameter_mode_t::DEFAULT ||
+            argument.parameter_mode == parameter_mode_t::CUSTOM) {
+            add_argument_promise_(argument.promise_id, call_stack_.back());
+        }
+
         /* set expression type for all arguments whether they are promises or
            not. */
         call_stack_.back()->set_expression_type(
@@ -132,14 +175,24 @@ void StrictnessAnalysis::builtin_exit(const builtin_info_t &builtin_info) {
 void StrictnessAnalysis::context_jump(const unwind_info_t &info) {
     for (auto &element : info.unwound_frames) {
         if (element.type == stack_type::CALL) {
-            CallState call_state{function_exit_(element.call_id, JUMPSXP)};
-            if (call_state.get_function_type() == "Closure") {
-                // serialize_arguments_(call_state);
-            }
+            function_exit_(element.call_id, JUMPSXP);
         }
     }
 }
 
+void StrictnessAnalysis::gc_promise_unmarked(const prom_id_t prom_id,
+                                             const SEXP promise) {
+    auto iter = argument_promises_.find(prom_id);
+
+    if (iter == argument_promises_.end()) {
+        return;
+    }
+
+    CallState *call_state = iter->second;
+    argument_promises_.erase(iter);
+    remove_argument_promise_(call_state);
+}
+
 void StrictnessAnalysis::promise_force_entry(const prom_info_t &prom_info,
                                              const SEXP promise) {
     PromiseState &promise_state{promise_mapper_->find(prom_info.prom_id)};
@@ -151,6 +204,11 @@ void StrictnessAnalysis::promise_force_entry(const prom_info_t &prom_info,
 
     auto *call_state = get_call_state(promise_state.call_id);
 
+    /* the promise belongs to a call that was not sampled */
+    if (call_state == nullptr) {
+        return;
+    }
+
     call_state->force_entry(promise, promise_state.formal_parameter_position);
 }
 
@@ -165,6 +223,11 @@ void StrictnessAnalysis::promise_force_exit(const prom_info_t &prom_info,
 
     auto *call_state = get_call_state(promise_state.call_id);
 
+    /* the promise belongs to a call that was not sampled */
+    if (call_state == nullptr) {
+        return;
+    }
+
     call_state->force_exit(promise, promise_state.formal_parameter_position);
 }
 
@@ -179,11 +242,16 @@ void StrictnessAnalysis::promise_value_lookup(const prom_info_t &prom_info,
 
     auto *call_state = get_call_state(promise_state.call_id);
 
+    /* the promise belongs to a call that was not sampled */
+    if (call_state == nullptr) {
+        return;
+    }
+
     call_state->lookup(promise_state.formal_parameter_position);
 }
 
-void StrictnessAnalysis::promise_value_assign(const prom_info_t &prom_info,
-                                              const SEXP promise) {
+void StrictnessAnalysis::promise_value_set(const prom_info_t &prom_info,
+                                           const SEXP promise) {
     metaprogram_(prom_info, promise);
 }
 
@@ -191,7 +259,7 @@ void StrictnessAnalysis::promise_environment_lookup(
     const prom_info_t &prom_info, const SEXP promise) {
     metaprogram_(prom_info, promise);
 }
-void StrictnessAnalysis::promise_environment_assign(
+void StrictnessAnalysis::promise_environment_set(
     const prom_info_t &prom_info, const SEXP promise) {
     metaprogram_(prom_info, promise);
 }
@@ -199,8 +267,8 @@ void StrictnessAnalysis::promise_expression_lookup(const prom_info_t &prom_info,
                                                    const SEXP promise) {
     metaprogram_(prom_info, promise);
 }
-void StrictnessAnalysis::promise_expression_assign(const prom_info_t &prom_info,
-                                                   const SEXP promise) {
+void StrictnessAnalysis::promise_expression_set(const prom_info_t &prom_info,
+                                                const SEXP promise) {
     metaprogram_(prom_info, promise);
 }
 
@@ -208,7 +276,12 @@ void StrictnessAnalysis::end(dyntracer_t *dyntracer) {
 
     for (const auto &key_value : call_map_) {
         serialize_arguments_(*key_value.second);
+        call_state_pool_.destroy(key_value.second);
     }
+
+    call_map_.clear();
+    call_stack_.clear();
+    argument_promises_.clear();
 }
 
 StrictnessAnalysis::~StrictnessAnalysis() {
@@ -228,7 +301,7 @@ void StrictnessAnalysis::serialize_arguments_(const CallState &call_state) {
 
         argument_data_table_->write_row(
             static_cast<double>(call_state.get_call_id()),
-            call_state.get_function_id(), position,
+            fn_id_to_string(call_state.get_function_id()), position,
             parameter_mode_to_string(parameter.get_parameter_mode()),
             sexptype_to_string(parameter.get_expression_type()),
             sexptype_to_string(parameter.get_value_type()),
@@ -240,7 +313,8 @@ void StrictnessAnalysis::serialize_arguments_(const CallState &call_state) {
 void StrictnessAnalysis::serialize_call_(const CallState &call_state) {
     call_data_table_->write_row(
         static_cast<double>(call_state.get_call_id()),
-        call_state.get_function_id(), call_state.get_function_type(),
+        fn_id_to_string(call_state.get_function_id()),
+        call_state.get_function_type(),
         call_state.get_formal_parameter_count(), call_state.get_function_name(),
         sexptype_to_string(call_state.get_return_value_type()),
         call_state.get_order(), call_state.get_intrinsic_order());
@@ -257,6 +331,11 @@ void StrictnessAnalysis::metaprogram_(const prom_info_t &prom_info,
 
     auto *call_state = get_call_state(promise_state.call_id);
 
+    /* the promise belongs to a call that was not sampled */
+    if (call_state == nullptr) {
+        return;
+    }
+
     call_state->metaprogram(promise_state.formal_parameter_position);
 }
 
@@ -273,7 +352,8 @@ CallState *StrictnessAnalysis::get_call_state(const call_id_t call_id) {
     }
 
     if (it == call_stack_.rend()) {
-        return call_map_.find(call_id)->second;
+        auto iter = call_map_.find(call_id);
+        return iter == call_map_.end() ? nullptr : iter->second;
     }
 
     (*it)->set_leaf(leaf);
@@ -294,7 +374,8 @@ void StrictnessAnalysis::write_function_body_(const fn_id_t &fn_id,
     auto result = handled_functions_.insert(fn_id);
     if (!result.second)
         return;
-    std::ofstream fout(output_dir_ + "/functions/" + fn_id, std::ios::trunc);
+    std::ofstream fout(output_dir_ + "/functions/" + fn_id_to_string(fn_id),
+                       std::ios::trunc);
     fout << definition;
     fout.close();
 }
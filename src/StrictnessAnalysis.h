@@ -1,8 +1,10 @@
 #ifndef __STRICTNESS_ANALYSIS_H__
 #define __STRICTNESS_ANALYSIS_H__
 
+#include "Analysis.h"
 #include "CallState.h"
 #include "FunctionState.h"
+#include "ObjectPool.h"
 #include "PromiseMapper.h"
 #include "State.h"
 #include "table.h"
@@ -11,12 +13,16 @@
 #include <unordered_map>
 #include <vector>
 
-class StrictnessAnalysis {
+class StrictnessAnalysis : public Analysis {
   public:
+    static const call_info_fields_t CALL_INFO_FIELDS;
+    static const probe_groups_t PROBE_GROUPS;
+
     StrictnessAnalysis(const tracer_state_t &tracer_state,
                        PromiseMapper *const promise_mapper,
                        const std::string &output_dir, bool truncate,
-                       bool binary, int compression_level);
+                       bool binary, int compression_level,
+                       int compression_threads);
     void closure_entry(const closure_info_t &closure_info);
     void special_entry(const builtin_info_t &special_info);
     void builtin_entry(const builtin_info_t &builtin_info);
@@ -26,15 +32,16 @@ class StrictnessAnalysis {
     void promise_force_entry(const prom_info_t &prom_info, const SEXP promise);
     void promise_force_exit(const prom_info_t &prom_info, const SEXP promise);
     void promise_value_lookup(const prom_info_t &prom_info, const SEXP promise);
-    void promise_value_assign(const prom_info_t &info, const SEXP promise);
+    void promise_value_set(const prom_info_t &info, const SEXP promise);
     void promise_environment_lookup(const prom_info_t &prom_info,
                                     const SEXP promise);
-    void promise_environment_assign(const prom_info_t &prom_info,
-                                    const SEXP promise);
+    void promise_environment_set(const prom_info_t &prom_info,
+                                 const SEXP promise);
     void promise_expression_lookup(const prom_info_t &prom_info,
                                    const SEXP promise);
-    void promise_expression_assign(const prom_info_t &prom_info,
-                                   const SEXP promise);
+    void promise_expression_set(const prom_info_t &prom_info,
+                                const SEXP promise);
+    void gc_promise_unmarked(const prom_id_t prom_id, const SEXP promise);
     void context_jump(const unwind_info_t &info);
     void end(dyntracer_t *dyntracer);
     ~StrictnessAnalysis();
@@ -51,7 +58,10 @@ class StrictnessAnalysis {
                          const std::string &fn_type, const std::string &name,
                          int formal_parameter_count, const std::string &order,
                          const std::string &definition);
-    CallState function_exit_(call_id_t call_id, sexptype_t return_value_type);
+    void function_exit_(call_id_t call_id, sexptype_t return_value_type);
+    void add_argument_promise_(prom_id_t promise_id, CallState *call_state);
+    void remove_argument_promise_(CallState *call_state);
+    void release_call_(CallState *call_state);
 
     const tracer_state_t &tracer_state_;
     std::string output_dir_;
@@ -63,8 +73,16 @@ class StrictnessAnalysis {
     DataTableStream *argument_data_table_;
     DataTableStream *call_data_table_;
     DataTableStream *call_graph_data_table_;
+    /* call states are recycled rather than freed as calls retire */
+    ObjectPool<CallState> call_state_pool_;
     std::vector<CallState *> call_stack_;
+    /* Active calls, and inactive calls some of whose argument promises are
+       still alive. The arguments of a call are written out and its state is
+       freed once it is inactive and its last argument promise has been
+       unmarked by the GC, so this is bounded by the live state. */
     std::unordered_map<call_id_t, CallState *> call_map_;
+    /* call whose argument each live promise currently is */
+    std::unordered_map<prom_id_t, CallState *> argument_promises_;
     std::unordered_set<fn_id_t> handled_functions_;
 };
 
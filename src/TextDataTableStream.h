@@ -11,9 +11,10 @@ class TextDataTableStream : public DataTableStream {
   public:
     explicit TextDataTableStream(const std::string &table_filepath,
                                  const std::vector<std::string> &column_names,
-                                 bool truncate, int compression_level)
+                                 bool truncate, int compression_level,
+                                 int compression_threads)
         : DataTableStream(table_filepath, column_names, truncate,
-                          compression_level) {
+                          compression_level, compression_threads) {
 
         contents_.reserve(1024);
 
@@ -2,35 +2,76 @@
 
 #include "Timer.h"
 
+#include <algorithm>
+
 DEFINE_ENUM(TimerSegment, TIMER_SEGMENT_ENUM, timer_segment_name,
             timer_segment_value)
 
-void Timer::start() { start_time = std::chrono::high_resolution_clock::now(); }
+Timer::Timer(const std::string &name)
+    : name_(name), calibration_ticks_(now_()),
+      calibration_nanoseconds_(monotonic_nanoseconds_()) {
+    start_time_ = calibration_ticks_;
+}
 
-void Timer::reset() { start_time = std::chrono::high_resolution_clock::now(); }
+void Timer::start() { reset(); }
 
 void Timer::zero() {
     for (int i = 0; i < TimerSegment::TIMER_SEGMENT_COUNT; i++)
-        timers[i] = 0;
+        segments_[i] = segment_t();
 }
 
-void Timer::end_segment(TimerSegment segment) {
-    auto end_time = std::chrono::high_resolution_clock::now();
-    const long duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                              end_time - start_time)
-                              .count();
-    timers[segment] += duration;
-    occurrences[segment]++;
-    start_time = std::chrono::high_resolution_clock::now();
+std::uint64_t Timer::bucket_upper_bound_(int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    const int msb = bucket / 4 + 1;
+    const std::uint64_t lower = (std::uint64_t)(4 + bucket % 4) << (msb - 2);
+    return lower + ((std::uint64_t)1 << (msb - 2)) - 1;
+}
+
+/* the upper bound of the bucket holding the percentile, at most the
+   maximum */
+std::uint64_t Timer::percentile_(const segment_t &stats,
+                                 double fraction) const {
+    if (stats.count == 0) {
+        return 0;
+    }
+    std::uint64_t rank = (std::uint64_t)(fraction * (stats.count - 1)) + 1;
+    for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        if (stats.buckets[bucket] >= rank) {
+            return std::min(bucket_upper_bound_(bucket), stats.max);
+        }
+        rank -= stats.buckets[bucket];
+    }
+    return stats.max;
 }
 
 std::vector<std::pair<std::string, std::string>> Timer::stats() {
     std::vector<std::pair<std::string, std::string>> r;
 
+    /* the clocks are compared over the lifetime of the timer, which makes
+       the rate of the time stamp counter exact to a few parts per million */
+    const double elapsed_ticks = (double)(now_() - calibration_ticks_);
+    const double elapsed_nanoseconds =
+        (double)(monotonic_nanoseconds_() - calibration_nanoseconds_);
+    const double nanoseconds_per_tick =
+        elapsed_ticks > 0 ? elapsed_nanoseconds / elapsed_ticks : 1;
+
+    auto to_nanoseconds = [nanoseconds_per_tick](std::uint64_t ticks) {
+        return std::to_string((std::uint64_t)(ticks * nanoseconds_per_tick));
+    };
+
     for (int i = 0; i < TimerSegment::TIMER_SEGMENT_COUNT; i++) {
-        r.push_back(std::make_pair(
-            "TIMER_" + name_ + "_" + timer_segment_name((TimerSegment)i),
-            std::to_string(timers[i]) + "/" + std::to_string(occurrences[i])));
+        const segment_t &stats = segments_[i];
+        const std::string name =
+            "TIMER_" + name_ + "_" + timer_segment_name((TimerSegment)i);
+        r.push_back(std::make_pair(name, to_nanoseconds(stats.total) + "/" +
+                                             std::to_string(stats.count)));
+        r.push_back(std::make_pair(name + "_P50",
+                                   to_nanoseconds(percentile_(stats, 0.5))));
+        r.push_back(std::make_pair(name + "_P99",
+                                   to_nanoseconds(percentile_(stats, 0.99))));
+        r.push_back(std::make_pair(name + "_MAX", to_nanoseconds(stats.max)));
     }
 
     return r;
@@ -4,9 +4,13 @@
 #ifdef DYNTRACE_ENABLE_TIMING
 
 #include "EnumFactory.h"
-#include <chrono>
+#include <cstdint>
+#include <ctime>
 #include <string>
 #include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #define TIMER_SEGMENT_ENUM(XX)                                                 \
     XX(BEGIN_SETUP, = 0)                                                       \
@@ -26,10 +30,6 @@
                                                                                \
     XX(FUNCTION_ENTRY_STACK, )                                                 \
     XX(FUNCTION_ENTRY_ANALYSIS, )                                              \
-    XX(FUNCTION_ENTRY_ANALYSIS_PROMISE_MAPPER, )                               \
-    XX(FUNCTION_ENTRY_ANALYSIS_FUNCTION, )                                     \
-    XX(FUNCTION_ENTRY_ANALYSIS_PROMISE_TYPE, )                                 \
-    XX(FUNCTION_ENTRY_ANALYSIS_STRICTNESS, )                                   \
     XX(FUNCTION_ENTRY_WRITE_TRACE, )                                           \
                                                                                \
     XX(FUNCTION_EXIT_RECORDER, )                                               \
@@ -46,84 +46,58 @@
                                                                                \
     XX(FUNCTION_EXIT_STACK, )                                                  \
     XX(FUNCTION_EXIT_ANALYSIS, )                                               \
-    XX(FUNCTION_EXIT_ANALYSIS_FUNCTION, )                                      \
-    XX(FUNCTION_EXIT_ANALYSIS_STRICTNESS, )                                    \
     XX(FUNCTION_EXIT_WRITE_TRACE, )                                            \
                                                                                \
     XX(BUILTIN_ENTRY_RECORDER, )                                               \
     XX(BUILTIN_ENTRY_STACK, )                                                  \
     XX(BUILTIN_ENTRY_ANALYSIS, )                                               \
-    XX(BUILTIN_ENTRY_ANALYSIS_FUNCTION, )                                      \
     XX(BUILTIN_ENTRY_WRITE_TRACE, )                                            \
                                                                                \
     XX(BUILTIN_EXIT_RECORDER, )                                                \
     XX(BUILTIN_EXIT_STACK, )                                                   \
     XX(BUILTIN_EXIT_ANALYSIS, )                                                \
-    XX(BUILTIN_EXIT_ANALYSIS_FUNCTION, )                                       \
     XX(BUILTIN_EXIT_WRITE_TRACE, )                                             \
                                                                                \
     XX(CREATE_PROMISE_RECORDER, )                                              \
     XX(CREATE_PROMISE_ANALYSIS, )                                              \
-    XX(CREATE_PROMISE_ANALYSIS_PROMISE_MAPPER, )                               \
-    XX(CREATE_PROMISE_ANALYSIS_FUNCTION, )                                     \
-    XX(CREATE_PROMISE_ANALYSIS_PROMISE_TYPE, )                                 \
     XX(CREATE_PROMISE_WRITE_TRACE, )                                           \
                                                                                \
     XX(FORCE_PROMISE_ENTRY_RECORDER, )                                         \
     XX(FORCE_PROMISE_ENTRY_STACK, )                                            \
     XX(FORCE_PROMISE_ENTRY_ANALYSIS, )                                         \
-    XX(FORCE_PROMISE_ENTRY_ANALYSIS_PROMISE_MAPPER, )                          \
-    XX(FORCE_PROMISE_ENTRY_ANALYSIS_PROMISE_EVALUATION_DISTANCE, )             \
-    XX(FORCE_PROMISE_ENTRY_ANALYSIS_STRICTNESS, )                              \
     XX(FORCE_PROMISE_ENTRY_WRITE_TRACE, )                                      \
                                                                                \
     XX(FORCE_PROMISE_EXIT_RECORDER, )                                          \
     XX(FORCE_PROMISE_EXIT_STACK, )                                             \
     XX(FORCE_PROMISE_EXIT_ANALYSIS, )                                          \
-    XX(FORCE_PROMISE_EXIT_ANALYSIS_PROMISE_TYPE, )                             \
     XX(FORCE_PROMISE_EXIT_WRITE_TRACE, )                                       \
                                                                                \
     XX(LOOKUP_PROMISE_VALUE_RECORDER, )                                        \
     XX(LOOKUP_PROMISE_VALUE_ANALYSIS, )                                        \
-    XX(LOOKUP_PROMISE_VALUE_ANALYSIS_PROMISE_MAPPER, )                         \
-    XX(LOOKUP_PROMISE_VALUE_ANALYSIS_STRICTNESS, )                             \
     XX(LOOKUP_PROMISE_VALUE_WRITE_TRACE, )                                     \
                                                                                \
     XX(LOOKUP_PROMISE_EXPRESSION_RECORDER, )                                   \
     XX(LOOKUP_PROMISE_EXPRESSION_ANALYSIS, )                                   \
-    XX(LOOKUP_PROMISE_EXPRESSION_ANALYSIS_PROMISE_MAPPER, )                    \
-    XX(LOOKUP_PROMISE_EXPRESSION_ANALYSIS_STRICTNESS, )                        \
     XX(LOOKUP_PROMISE_EXPRESSION_WRITE_TRACE, )                                \
                                                                                \
     XX(LOOKUP_PROMISE_ENVIRONMENT_RECORDER, )                                  \
     XX(LOOKUP_PROMISE_ENVIRONMENT_ANALYSIS, )                                  \
-    XX(LOOKUP_PROMISE_ENVIRONMENT_ANALYSIS_PROMISE_MAPPER, )                   \
-    XX(LOOKUP_PROMISE_ENVIRONMENT_ANALYSIS_STRICTNESS, )                       \
     XX(LOOKUP_PROMISE_ENVIRONMENT_WRITE_TRACE, )                               \
                                                                                \
     XX(SET_PROMISE_VALUE_RECORDER, )                                           \
     XX(SET_PROMISE_VALUE_ANALYSIS, )                                           \
-    XX(SET_PROMISE_VALUE_ANALYSIS_PROMISE_MAPPER, )                            \
-    XX(SET_PROMISE_VALUE_ANALYSIS_STRICTNESS, )                                \
     XX(SET_PROMISE_VALUE_WRITE_TRACE, )                                        \
                                                                                \
     XX(SET_PROMISE_EXPRESSION_RECORDER, )                                      \
     XX(SET_PROMISE_EXPRESSION_ANALYSIS, )                                      \
-    XX(SET_PROMISE_EXPRESSION_ANALYSIS_PROMISE_MAPPER, )                       \
-    XX(SET_PROMISE_EXPRESSION_ANALYSIS_STRICTNESS, )                           \
     XX(SET_PROMISE_EXPRESSION_WRITE_TRACE, )                                   \
                                                                                \
     XX(SET_PROMISE_ENVIRONMENT_RECORDER, )                                     \
     XX(SET_PROMISE_ENVIRONMENT_ANALYSIS, )                                     \
-    XX(SET_PROMISE_ENVIRONMENT_ANALYSIS_PROMISE_MAPPER, )                      \
-    XX(SET_PROMISE_ENVIRONMENT_ANALYSIS_STRICTNESS, )                          \
     XX(SET_PROMISE_ENVIRONMENT_WRITE_TRACE, )                                  \
                                                                                \
     XX(GC_PROMISE_UNMARKED_RECORDER, )                                         \
     XX(GC_PROMISE_UNMARKED_ANALYSIS, )                                         \
-    XX(GC_PROMISE_UNMARKED_ANALYSIS_PROMISE_MAPPER, )                          \
-    XX(GC_PROMISE_UNMARKED_ANALYSIS_STRICTNESS, )                              \
-    XX(GC_PROMISE_UNMARKED_ANALYSIS_PROMISE_TYPE, )                            \
     XX(GC_PROMISE_UNMARKED_RECORD_KEEPING, )                                   \
                                                                                \
     XX(GC_FUNCTION_UNMARKED_RECORD_KEEPING, )                                  \
@@ -134,7 +108,6 @@
                                                                                \
     XX(VECTOR_ALLOC_RECORDER, )                                                \
     XX(VECTOR_ALLOC_ANALYSIS, )                                                \
-    XX(VECTOR_ALLOC_ANALYSIS_OBJECT_COUNT_SIZE, )                              \
                                                                                \
     XX(NEW_ENVIRONMENT_RECORDER, )                                             \
     XX(NEW_ENVIRONMENT_WRITE_TRACE, )                                          \
@@ -143,38 +116,45 @@
                                                                                \
     XX(CONTEXT_JUMP_STACK, )                                                   \
     XX(CONTEXT_JUMP_ANALYSIS, )                                                \
-    XX(CONTEXT_JUMP_ANALYSIS_STRICTNESS, )                                     \
                                                                                \
     XX(CONTEXT_EXIT_STACK, )                                                   \
                                                                                \
     XX(ENVIRONMENT_ACTION_RECORDER, )                                          \
     XX(ENVIRONMENT_ACTION_ANALYSIS, )                                          \
-    XX(ENVIRONMENT_ACTION_ANALYSIS_SIDE_EFFECT, )                              \
     XX(ENVIRONMENT_ACTION_WRITE_TRACE, )                                       \
                                                                                \
     XX(END_CHECK, )                                                            \
     XX(END_ANALYSIS, )                                                         \
-    XX(END_ANALYSIS_PROMISE_MAPPER, )                                          \
-    XX(END_ANALYSIS_PROMISE_TYPE, )                                            \
-    XX(END_ANALYSIS_METADATA, )                                                \
-    XX(END_ANALYSIS_OBJECT_COUNT_SIZE, )                                       \
-    XX(END_ANALYSIS_FUNCTION, )                                                \
-    XX(END_ANALYSIS_PROMISE, )                                                 \
-    XX(END_ANALYSIS_PROMISE_EVALUATION_DISTANCE, )                             \
-    XX(END_ANALYSIS_STRICTNESS, )                                              \
-    XX(END_ANALYSIS_SIDE_EFFECT, )                                             \
+                                                                               \
+    XX(PROMISE_MAPPER, )                                                       \
+    XX(OBJECT_COUNT_SIZE_ANALYSIS, )                                           \
+    XX(PROMISE_TYPE_ANALYSIS, )                                                \
+    XX(PROMISE_EVALUATION_ANALYSIS, )                                          \
+    XX(STRICTNESS_ANALYSIS, )                                                  \
+    XX(SIDE_EFFECT_ANALYSIS, )                                                 \
                                                                                \
     XX(TIMER_SEGMENT_COUNT, )
 
 DECLARE_ENUM(TimerSegment, TIMER_SEGMENT_ENUM, timer_segment_name,
              timer_segment_value)
 
+/* Times the segments of the probes. Every segment boundary reads the clock
+   once: the end of a segment is the start of the next one. The clock is the
+   time stamp counter on x86, converted to nanoseconds by comparing it with
+   CLOCK_MONOTONIC_RAW over the whole run, and CLOCK_MONOTONIC_RAW elsewhere.
+   Besides the total, each segment keeps the maximum and a histogram of its
+   durations with four buckets per power of two, from which stats reports
+   the median and the 99th percentile to within a quarter. */
 class Timer {
   public:
     void start();
-    void reset();
+    void reset() { start_time_ = now_(); }
     void zero();
-    void end_segment(TimerSegment segment);
+    void end_segment(TimerSegment segment) {
+        const std::uint64_t end_time = now_();
+        record_(segment, end_time - start_time_);
+        start_time_ = end_time;
+    }
     std::vector<std::pair<std::string, std::string>> stats();
 
     Timer(Timer const &) = delete;
@@ -197,13 +177,68 @@ class Timer {
         return analysis_timer;
     }
 
+    /* time spent in each analysis type, summed over all events */
+    static Timer &analyses_timer() {
+        static Timer analyses_timer("ANALYSES");
+        return analyses_timer;
+    }
+
   private:
-    Timer(const std::string &name) : name_(name){};
+    /* durations below 4 ticks have a bucket each, above that every power of
+       two is split in four */
+    static const int BUCKET_COUNT = 252;
+
+    struct segment_t {
+        std::uint64_t total;
+        std::uint64_t count;
+        std::uint64_t max;
+        std::uint64_t buckets[BUCKET_COUNT];
+    };
+
+    Timer(const std::string &name);
+
+    static std::uint64_t now_() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return monotonic_nanoseconds_();
+#endif
+    }
+
+    static std::uint64_t monotonic_nanoseconds_() {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+        return time.tv_sec * 1000000000ULL + time.tv_nsec;
+    }
+
+    static int bucket_(std::uint64_t ticks) {
+        if (ticks < 4) {
+            return (int)ticks;
+        }
+        const int msb = 63 - __builtin_clzll(ticks);
+        return (msb - 1) * 4 + (int)((ticks >> (msb - 2)) & 3);
+    }
+
+    static std::uint64_t bucket_upper_bound_(int bucket);
+
+    void record_(TimerSegment segment, std::uint64_t ticks) {
+        segment_t &stats = segments_[segment];
+        stats.total += ticks;
+        ++stats.count;
+        if (ticks > stats.max) {
+            stats.max = ticks;
+        }
+        ++stats.buckets[bucket_(ticks)];
+    }
+
+    std::uint64_t percentile_(const segment_t &stats, double fraction) const;
 
     std::string name_;
-    long timers[TimerSegment::TIMER_SEGMENT_COUNT] = {0};
-    long occurrences[TimerSegment::TIMER_SEGMENT_COUNT] = {0};
-    std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
+    segment_t segments_[TimerSegment::TIMER_SEGMENT_COUNT] = {};
+    std::uint64_t start_time_;
+    /* calibration of the ticks, read when the timer is created */
+    std::uint64_t calibration_ticks_;
+    std::uint64_t calibration_nanoseconds_;
 };
 
 #define MAIN_TIMER_RESET() Timer::main_timer().reset();
@@ -216,11 +251,16 @@ class Timer {
 #define RECORDER_TIMER_END_SEGMENT(segment_name)                               \
     Timer::recorder_timer().end_segment(TimerSegment::segment_name);
 
-#define ANALYSIS_TIMER_RESET() Timer::recorder_timer().reset();
+#define ANALYSIS_TIMER_RESET() Timer::analysis_timer().reset();
 
 #define ANALYSIS_TIMER_END_SEGMENT(segment_name)                               \
     Timer::analysis_timer().end_segment(TimerSegment::segment_name);
 
+#define ANALYSES_TIMER_RESET() Timer::analyses_timer().reset();
+
+#define ANALYSES_TIMER_END_SEGMENT(segment)                                    \
+    Timer::analyses_timer().end_segment(segment);
+
 #else /* DYNTRACE_ENABLE_TIMING */
 
 #define MAIN_TIMER_RESET()                                                     \
@@ -235,6 +275,10 @@ class Timer {
     {}
 #define ANALYSIS_TIMER_END_SEGMENT(segment_name)                               \
     {}
+#define ANALYSES_TIMER_RESET()                                                 \
+    {}
+#define ANALYSES_TIMER_END_SEGMENT(segment)                                    \
+    {}
 
 #endif /* DYNTRACE_ENABLE_TIMING */
 
@@ -1,19 +1,40 @@
 #include "TraceSerializer.h"
 
-const std::string TraceSerializer::OPCODE_FUNCTION_BEGIN = "fnb";
-const std::string TraceSerializer::OPCODE_FUNCTION_FINISH = "fnf";
-const std::string TraceSerializer::OPCODE_ARGUMENT_PROMISE_ASSOCIATE = "apa";
-const std::string TraceSerializer::OPCODE_PROMISE_CREATE = "prc";
-const std::string TraceSerializer::OPCODE_PROMISE_BEGIN = "prb";
-const std::string TraceSerializer::OPCODE_PROMISE_FINISH = "prf";
-const std::string TraceSerializer::OPCODE_PROMISE_VALUE_LOOKUP = "pvl";
-const std::string TraceSerializer::OPCODE_PROMISE_EXPRESSION_LOOKUP = "pel";
-const std::string TraceSerializer::OPCODE_PROMISE_ENVIRONMENT_LOOKUP = "prl";
-const std::string TraceSerializer::OPCODE_PROMISE_VALUE_ASSIGN = "pva";
-const std::string TraceSerializer::OPCODE_PROMISE_EXPRESSION_ASSIGN = "pea";
-const std::string TraceSerializer::OPCODE_PROMISE_ENVIRONMENT_ASSIGN = "pra";
-const std::string TraceSerializer::OPCODE_ENVIRONMENT_CREATE = "enc";
-const std::string TraceSerializer::OPCODE_ENVIRONMENT_ASSIGN = "ena";
-const std::string TraceSerializer::OPCODE_ENVIRONMENT_REMOVE = "enr";
-const std::string TraceSerializer::OPCODE_ENVIRONMENT_DEFINE = "end";
-const std::string TraceSerializer::OPCODE_ENVIRONMENT_LOOKUP = "enl";
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_FUNCTION_BEGIN = 0;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_FUNCTION_FINISH = 1;
+const TraceSerializer::opcode_t
+    TraceSerializer::OPCODE_ARGUMENT_PROMISE_ASSOCIATE = 2;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_PROMISE_CREATE = 3;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_PROMISE_BEGIN = 4;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_PROMISE_FINISH = 5;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_PROMISE_VALUE_LOOKUP =
+    6;
+const TraceSerializer::opcode_t
+    TraceSerializer::OPCODE_PROMISE_EXPRESSION_LOOKUP = 7;
+const TraceSerializer::opcode_t
+    TraceSerializer::OPCODE_PROMISE_ENVIRONMENT_LOOKUP = 8;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_PROMISE_VALUE_ASSIGN =
+    9;
+const TraceSerializer::opcode_t
+    TraceSerializer::OPCODE_PROMISE_EXPRESSION_ASSIGN = 10;
+const TraceSerializer::opcode_t
+    TraceSerializer::OPCODE_PROMISE_ENVIRONMENT_ASSIGN = 11;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_ENVIRONMENT_CREATE = 12;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_ENVIRONMENT_ASSIGN = 13;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_ENVIRONMENT_REMOVE = 14;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_ENVIRONMENT_DEFINE = 15;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_ENVIRONMENT_LOOKUP = 16;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_COUNT = 17;
+const TraceSerializer::opcode_t TraceSerializer::OPCODE_STRINGS_RESET = 255;
+
+const std::string TraceSerializer::BINARY_TRACE_MAGIC = "PDTB";
+const std::uint8_t TraceSerializer::BINARY_TRACE_VERSION = 2;
+
+const std::string &TraceSerializer::opcode_to_string(opcode_t opcode) {
+    /* indexed by opcode, the order has to match the definitions above */
+    static const std::vector<std::string> mnemonics{
+        "fnb", "fnf", "apa", "prc", "prb", "prf", "pvl", "pel", "prl",
+        "pva", "pea", "pra", "enc", "ena", "enr", "end", "enl"};
+    static const std::string unknown{"???"};
+    return opcode < mnemonics.size() ? mnemonics[opcode] : unknown;
+}
@@ -1,54 +1,128 @@
 #ifndef __TRACE_SERIALIZER_H__
 #define __TRACE_SERIALIZER_H__
 
+#include "AsyncStream.h"
+#include "BufferStream.h"
+#include "FileStream.h"
+#include "Sampler.h"
 #include "State.h"
+#include "ZstdCompressionStream.h"
 #include "stdlibs.h"
 #include "utilities.h"
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <type_traits>
 
+/* The trace is written in one of two encodings.
+
+   TEXT   - every record is a sequence of fields separated by UNIT_SEPARATOR
+            and terminated by RECORD_SEPARATOR and a newline. The first field
+            is the three letter opcode mnemonic.
+
+   BINARY - the file starts with BINARY_TRACE_MAGIC and a version byte.
+            Every record is a one byte opcode followed by a one byte field
+            count and the fields. Each field is a single varint whose lowest
+            bit is the field kind. Integer fields are zigzag encoded. String
+            fields are interned; the first occurrence carries the bytes and
+            subsequent occurrences refer to it by index. Long strings are
+            written inline without interning to keep the table small. Once
+            the table holds MAXIMUM_INTERNED_STRING_COUNT strings, it is
+            emptied and an OPCODE_STRINGS_RESET record without fields tells
+            the decoder to empty its own.
+
+   Both encodings go through the same FileStream, BufferStream, optional
+   ZstdCompressionStream and AsyncStream chain used for data tables, so
+   compression and file writes happen on a separate writer thread.
+   decode_trace (trace.h) converts a binary trace back into the text
+   encoding. */
 class TraceSerializer {
   public:
-    static const std::string OPCODE_FUNCTION_BEGIN;
-    static const std::string OPCODE_FUNCTION_FINISH;
-    static const std::string OPCODE_ARGUMENT_PROMISE_ASSOCIATE;
-    static const std::string OPCODE_PROMISE_CREATE;
-    static const std::string OPCODE_PROMISE_BEGIN;
-    static const std::string OPCODE_PROMISE_FINISH;
-    static const std::string OPCODE_PROMISE_VALUE_LOOKUP;
-    static const std::string OPCODE_PROMISE_EXPRESSION_LOOKUP;
-    static const std::string OPCODE_PROMISE_ENVIRONMENT_LOOKUP;
-    static const std::string OPCODE_PROMISE_VALUE_ASSIGN;
-    static const std::string OPCODE_PROMISE_EXPRESSION_ASSIGN;
-    static const std::string OPCODE_PROMISE_ENVIRONMENT_ASSIGN;
-    static const std::string OPCODE_ENVIRONMENT_CREATE;
-    static const std::string OPCODE_ENVIRONMENT_ASSIGN;
-    static const std::string OPCODE_ENVIRONMENT_REMOVE;
-    static const std::string OPCODE_ENVIRONMENT_DEFINE;
-    static const std::string OPCODE_ENVIRONMENT_LOOKUP;
+    using opcode_t = std::uint8_t;
+
+    static const opcode_t OPCODE_FUNCTION_BEGIN;
+    static const opcode_t OPCODE_FUNCTION_FINISH;
+    static const opcode_t OPCODE_ARGUMENT_PROMISE_ASSOCIATE;
+    static const opcode_t OPCODE_PROMISE_CREATE;
+    static const opcode_t OPCODE_PROMISE_BEGIN;
+    static const opcode_t OPCODE_PROMISE_FINISH;
+    static const opcode_t OPCODE_PROMISE_VALUE_LOOKUP;
+    static const opcode_t OPCODE_PROMISE_EXPRESSION_LOOKUP;
+    static const opcode_t OPCODE_PROMISE_ENVIRONMENT_LOOKUP;
+    static const opcode_t OPCODE_PROMISE_VALUE_ASSIGN;
+    static const opcode_t OPCODE_PROMISE_EXPRESSION_ASSIGN;
+    static const opcode_t OPCODE_PROMISE_ENVIRONMENT_ASSIGN;
+    static const opcode_t OPCODE_ENVIRONMENT_CREATE;
+    static const opcode_t OPCODE_ENVIRONMENT_ASSIGN;
+    static const opcode_t OPCODE_ENVIRONMENT_REMOVE;
+    static const opcode_t OPCODE_ENVIRONMENT_DEFINE;
+    static const opcode_t OPCODE_ENVIRONMENT_LOOKUP;
+    static const opcode_t OPCODE_COUNT;
+    /* not an event, empties the string table of the decoder */
+    static const opcode_t OPCODE_STRINGS_RESET;
+
+    static const std::string BINARY_TRACE_MAGIC;
+    static const std::uint8_t BINARY_TRACE_VERSION;
+
+    /* lowest bit of every binary field */
+    static constexpr std::uint64_t FIELD_INTEGER = 0;
+    static constexpr std::uint64_t FIELD_STRING = 1;
+    /* next two bits of every binary string field */
+    static constexpr std::uint64_t STRING_REFERENCE = 0;
+    static constexpr std::uint64_t STRING_DEFINITION = 1;
+    static constexpr std::uint64_t STRING_LITERAL = 2;
+    /* strings longer than this are never interned */
+    static constexpr std::size_t MAXIMUM_INTERNED_STRING_SIZE = 256;
+    /* bounds the string tables of the serializer and the decoder */
+    static constexpr std::size_t MAXIMUM_INTERNED_STRING_COUNT = 1 << 16;
+
+    static const std::string &opcode_to_string(opcode_t opcode);
 
     TraceSerializer(std::string trace_filepath, bool truncate,
-                    bool enable_trace)
-        : trace_filepath(trace_filepath), enable_trace_(enable_trace) {
-        open_trace(trace_filepath, truncate);
+                    bool enable_trace, bool binary, int compression_level,
+                    int compression_threads, const Sampler &sampler)
+        : trace_filepath(trace_filepath), enable_trace_(enable_trace),
+          binary_(binary), sampler_(sampler), file_stream_{nullptr},
+          buffer_stream_{nullptr}, zstd_compression_stream_{nullptr},
+          async_stream_{nullptr}, sink_{nullptr} {
+        open_trace(trace_filepath, truncate, compression_level,
+                   compression_threads);
     }
 
-    template <typename T> void serialize(T value) {
-        if (enable_trace()) {
-            trace << value << RECORD_SEPARATOR << std::endl;
+    template <typename... Args>
+    void serialize(opcode_t opcode, const Args &... args) {
+        if (!enable_trace() || !sampler_.is_sampled()) {
+            return;
         }
-    }
 
-    template <typename T, typename... Args>
-    void serialize(T value, Args... args) {
-        if (enable_trace()) {
-            trace << value << UNIT_SEPARATOR;
-            serialize(args...);
+        record_.clear();
+
+        if (binary_) {
+            if (strings_.size() >= MAXIMUM_INTERNED_STRING_COUNT) {
+                strings_.clear();
+                string_storage_.clear();
+                symbol_names_.clear();
+                record_.push_back(static_cast<char>(OPCODE_STRINGS_RESET));
+                record_.push_back(0);
+            }
+            record_.push_back(static_cast<char>(opcode));
+            record_.push_back(static_cast<char>(sizeof...(args)));
+            (encode_field_(args), ...);
+        } else {
+            record_.append(opcode_to_string(opcode));
+            (append_field_(args), ...);
+            record_.push_back(RECORD_SEPARATOR);
+            record_.push_back('\n');
         }
+
+        sink_->write(record_.data(), record_.size());
     }
 
     ~TraceSerializer() { close_trace(); }
 
   private:
-    void open_trace(const std::string &trace_filepath, bool truncate) {
+    void open_trace(const std::string &trace_filepath, bool truncate,
+                    int compression_level, int compression_threads) {
         if (!enable_trace())
             return;
         if (file_exists(trace_filepath)) {
@@ -60,25 +134,144 @@ class TraceSerializer {
                                    trace_filepath.c_str());
             }
         }
-        trace.open(trace_filepath);
-        if (!trace.good()) {
-            close_trace();
-            dyntrace_log_error(
-                "invalid state of stream object associated with %s",
-                trace_filepath.c_str());
+
+        file_stream_ =
+            new FileStream(trace_filepath, O_WRONLY | O_CREAT | O_TRUNC);
+        buffer_stream_ = new BufferStream(file_stream_);
+        sink_ = buffer_stream_;
+
+        if (compression_level > 0) {
+            zstd_compression_stream_ =
+                new ZstdCompressionStream(buffer_stream_, compression_level,
+                                          compression_threads);
+            sink_ = zstd_compression_stream_;
+        }
+
+        async_stream_ = new AsyncStream(sink_);
+        sink_ = async_stream_;
+
+        if (binary_) {
+            sink_->write(BINARY_TRACE_MAGIC.data(), BINARY_TRACE_MAGIC.size());
+            sink_->write(&BINARY_TRACE_VERSION, 1);
         }
     }
 
     void close_trace() {
-        if (trace.is_open())
-            trace.close();
+        /* the async stream drains its blocks into the compression stream
+           which writes the end of frame to the buffer stream which flushes
+           it to the file on deletion. */
+        delete async_stream_;
+        delete zstd_compression_stream_;
+        delete buffer_stream_;
+        delete file_stream_;
+        async_stream_ = nullptr;
+        zstd_compression_stream_ = nullptr;
+        buffer_stream_ = nullptr;
+        file_stream_ = nullptr;
+        sink_ = nullptr;
     }
 
     bool enable_trace() const { return enable_trace_; }
 
+    template <typename T> void append_field_(const T &value) {
+        record_.push_back(UNIT_SEPARATOR);
+        if constexpr (std::is_same<T, fn_id_field_t>::value) {
+            record_.append(fn_id_to_string(value.fn_id));
+        } else if constexpr (std::is_same<T, symbol_field_t>::value) {
+            record_.append(CHAR(PRINTNAME(value.symbol)));
+        } else if constexpr (std::is_same<T, bool>::value) {
+            record_.push_back(value ? '1' : '0');
+        } else if constexpr (std::is_integral<T>::value) {
+            record_.append(std::to_string(value));
+        } else {
+            record_.append(value);
+        }
+    }
+
+    template <typename T> void encode_field_(const T &value) {
+        if constexpr (std::is_same<T, fn_id_field_t>::value) {
+            encode_string_(fn_id_to_string(value.fn_id));
+        } else if constexpr (std::is_same<T, symbol_field_t>::value) {
+            encode_symbol_(value.symbol);
+        } else if constexpr (std::is_integral<T>::value) {
+            encode_integer_(static_cast<std::int64_t>(value));
+        } else {
+            encode_string_(value);
+        }
+    }
+
+    void encode_integer_(std::int64_t value) {
+        std::uint64_t zigzag = (static_cast<std::uint64_t>(value) << 1) ^
+                               static_cast<std::uint64_t>(value >> 63);
+        encode_varint_((zigzag << 1) | FIELD_INTEGER);
+    }
+
+    /* looks value up without copying it, only a new string is copied into
+       string_storage_ which the keys of strings_ point to */
+    void encode_string_(std::string_view value) {
+        if (value.size() > MAXIMUM_INTERNED_STRING_SIZE) {
+            encode_string_header_(STRING_LITERAL, value.size());
+            record_.append(value.data(), value.size());
+            return;
+        }
+
+        auto it = strings_.find(value);
+
+        if (it != strings_.end()) {
+            encode_string_header_(STRING_REFERENCE, it->second);
+            return;
+        }
+
+        const std::string &stored = string_storage_.emplace_back(value);
+        strings_.emplace(stored, strings_.size());
+        encode_string_header_(STRING_DEFINITION, value.size());
+        record_.append(value.data(), value.size());
+    }
+
+    /* Encodes the name of symbol like encode_string_, but finds a name seen
+       before by the address of its PRINTNAME without hashing its bytes. */
+    void encode_symbol_(SEXP symbol) {
+        const SEXP name = PRINTNAME(symbol);
+        auto it = symbol_names_.find(name);
+        if (it != symbol_names_.end()) {
+            encode_string_header_(STRING_REFERENCE, it->second);
+            return;
+        }
+        const std::string_view value(CHAR(name));
+        encode_string_(value);
+        auto string = strings_.find(value);
+        if (string != strings_.end()) {
+            symbol_names_.try_emplace(name, string->second);
+        }
+    }
+
+    void encode_string_header_(std::uint64_t kind, std::uint64_t payload) {
+        encode_varint_((((payload << 2) | kind) << 1) | FIELD_STRING);
+    }
+
+    void encode_varint_(std::uint64_t value) {
+        while (value >= 0x80) {
+            record_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        record_.push_back(static_cast<char>(value));
+    }
+
     std::string trace_filepath;
-    std::ofstream trace;
     bool enable_trace_;
+    bool binary_;
+    const Sampler &sampler_;
+    FileStream *file_stream_;
+    BufferStream *buffer_stream_;
+    ZstdCompressionStream *zstd_compression_stream_;
+    AsyncStream *async_stream_;
+    Stream *sink_;
+    std::string record_;
+    std::unordered_map<std::string_view, std::uint64_t> strings_;
+    /* never moves its strings, unlike a vector */
+    std::deque<std::string> string_storage_;
+    /* string index of the interned PRINTNAME of symbols */
+    FlatHashMap<SEXP, std::uint64_t> symbol_names_;
 };
 
 #endif /* __TRACE_SERIALIZER_H__ */
@@ -6,9 +6,14 @@
 
 class ZstdCompressionStream : public Stream {
   public:
-    ZstdCompressionStream(Stream *sink, int compression_level)
+    /* compression_threads > 0 enables zstd's multithreaded frame
+       compression with that many worker threads. The output is a single
+       regular frame either way. */
+    ZstdCompressionStream(Stream *sink, int compression_level,
+                          int compression_threads = 0)
         : Stream(sink), compression_level_{compression_level},
-          input_buffer_{nullptr}, input_buffer_size_{0}, input_buffer_index_{0},
+          compression_threads_{0}, input_buffer_{nullptr},
+          input_buffer_size_{0}, input_buffer_index_{0},
           output_buffer_{nullptr}, output_buffer_size_{0},
           compression_stream_{nullptr} {
 
@@ -19,24 +24,41 @@ class ZstdCompressionStream : public Stream {
         output_buffer_ =
             static_cast<char *>(malloc_or_die(output_buffer_size_));
 
-        compression_stream_ = ZSTD_createCStream();
+        compression_stream_ = ZSTD_createCCtx();
         if (compression_stream_ == NULL) {
-            fprintf(stderr, "ZSTD_createCStream() error \n");
+            fprintf(stderr, "ZSTD_createCCtx() error \n");
             exit(EXIT_FAILURE);
         }
 
-        const size_t init_result =
-            ZSTD_initCStream(compression_stream_, compression_level_);
+        const size_t level_result = ZSTD_CCtx_setParameter(
+            compression_stream_, ZSTD_c_compressionLevel, compression_level_);
 
-        if (ZSTD_isError(init_result)) {
-            fprintf(stderr, "ZSTD_initCStream() error : %s \n",
-                    ZSTD_getErrorName(init_result));
+        if (ZSTD_isError(level_result)) {
+            fprintf(stderr, "ZSTD_CCtx_setParameter() error : %s \n",
+                    ZSTD_getErrorName(level_result));
             exit(EXIT_FAILURE);
         }
+
+        if (compression_threads > 0) {
+            const size_t workers_result = ZSTD_CCtx_setParameter(
+                compression_stream_, ZSTD_c_nbWorkers, compression_threads);
+            /* libzstd built without multithreading support rejects this
+               parameter, compress on the calling thread in that case. */
+            if (ZSTD_isError(workers_result)) {
+                fprintf(stderr,
+                        "ZSTD_CCtx_setParameter() warning : %s, compressing "
+                        "with a single thread \n",
+                        ZSTD_getErrorName(workers_result));
+            } else {
+                compression_threads_ = compression_threads;
+            }
+        }
     }
 
     int get_compression_level() const { return compression_level_; }
 
+    int get_compression_threads() const { return compression_threads_; }
+
     void write(const void *buffer, std::size_t bytes) override {
         const char *buf = static_cast<const char *>(buffer);
         std::size_t copied_bytes = 0;
@@ -58,24 +80,18 @@ class ZstdCompressionStream : public Stream {
         }
         ZSTD_inBuffer input{input_buffer_, input_buffer_index_, 0};
         ZSTD_outBuffer output{output_buffer_, output_buffer_size_, 0};
-        std::size_t compressed_bytes = 0;
+        std::size_t result = 0;
         while (input.pos < input.size) {
             output.pos = 0;
-            /* compressed_bytes is guaranteed to be <= ZSTD_CStreamInSize() */
-            compressed_bytes =
-                ZSTD_compressStream(compression_stream_, &output, &input);
+            result = ZSTD_compressStream2(compression_stream_, &output, &input,
+                                          ZSTD_e_continue);
 
-            if (ZSTD_isError(compressed_bytes)) {
-                fprintf(stderr, "ZSTD_compressStream() error : %s \n",
-                        ZSTD_getErrorName(compressed_bytes));
+            if (ZSTD_isError(result)) {
+                fprintf(stderr, "ZSTD_compressStream2() error : %s \n",
+                        ZSTD_getErrorName(result));
                 exit(EXIT_FAILURE);
             }
 
-            /* Safely handle case when `buffInSize` is manually changed to a
-               value < ZSTD_CStreamInSize()*/
-            if (compressed_bytes > input.size)
-                compressed_bytes = input.size;
-
             get_sink()->write(output.dst, output.pos);
         }
 
@@ -87,22 +103,25 @@ class ZstdCompressionStream : public Stream {
             return;
         }
         flush();
-        size_t unflushed;
-        ZSTD_outBuffer output = {output_buffer_, output_buffer_size_, 0};
-        while ((unflushed = ZSTD_endStream(compression_stream_, &output))) {
-            /* close frame */
+        ZSTD_inBuffer input{input_buffer_, 0, 0};
+        ZSTD_outBuffer output{output_buffer_, output_buffer_size_, 0};
+        std::size_t unflushed = 0;
+        do {
+            /* close frame, with worker threads this also waits for all
+               pending jobs */
+            output.pos = 0;
+            unflushed = ZSTD_compressStream2(compression_stream_, &output,
+                                             &input, ZSTD_e_end);
             if (ZSTD_isError(unflushed)) {
-                fprintf(stderr, "ZSTD_endStream() error : %s \n",
+                fprintf(stderr, "ZSTD_compressStream2() error : %s \n",
                         ZSTD_getErrorName(unflushed));
                 exit(EXIT_FAILURE);
             }
             get_sink()->write(output.dst, output.pos);
-            output.pos = 0;
-        }
-        /* handles the remaining output in buffer after the loop */
-        get_sink()->write(output.dst, output.pos);
+        } while (unflushed != 0);
 
-        ZSTD_freeCStream(compression_stream_);
+        ZSTD_freeCCtx(compression_stream_);
+        compression_stream_ = nullptr;
         std::free(input_buffer_);
         input_buffer_ = nullptr;
         input_buffer_size_ = 0;
@@ -116,12 +135,13 @@ class ZstdCompressionStream : public Stream {
 
   private:
     int compression_level_;
+    int compression_threads_;
     char *input_buffer_;
     std::size_t input_buffer_size_;
     std::size_t input_buffer_index_;
     char *output_buffer_;
     std::size_t output_buffer_size_;
-    ZSTD_CStream *compression_stream_;
+    ZSTD_CCtx *compression_stream_;
 };
 
 #endif /* PROMISEDYNTRACER_ZSTD_COMPRESSION_STREAM_H */
@@ -0,0 +1,69 @@
+#ifndef PROMISEDYNTRACER_ZSTD_DECOMPRESSION_STREAM_H
+#define PROMISEDYNTRACER_ZSTD_DECOMPRESSION_STREAM_H
+
+#include "utilities.h"
+#include <cstdint>
+#include <zstd.h>
+
+/* Unlike the output streams, this stream is pulled from. It decompresses
+   an in-memory (usually memory mapped) zstd payload into the caller's
+   buffer on demand, so the decompressed contents never exist in full.
+   Corrupt and truncated payloads raise a format_error. */
+class ZstdDecompressionStream {
+  public:
+    ZstdDecompressionStream(const void *buffer, std::size_t bytes)
+        : input_{buffer, bytes, 0}, decompression_stream_{nullptr} {
+
+        decompression_stream_ = ZSTD_createDStream();
+        if (decompression_stream_ == NULL) {
+            raise_format_error("ZSTD_createDStream() error");
+        }
+
+        const size_t init_result = ZSTD_initDStream(decompression_stream_);
+
+        if (ZSTD_isError(init_result)) {
+            /* the destructor does not run for a throwing constructor */
+            ZSTD_freeDStream(decompression_stream_);
+            raise_format_error("ZSTD_initDStream() error : %s",
+                               ZSTD_getErrorName(init_result));
+        }
+    }
+
+    static bool is_compressed(const void *buffer, std::size_t bytes) {
+        const unsigned char *buf = static_cast<const unsigned char *>(buffer);
+        return bytes >= 4 && buf[0] == 0x28 && buf[1] == 0xB5 &&
+               buf[2] == 0x2F && buf[3] == 0xFD;
+    }
+
+    /* returns the number of bytes written to buffer, which is less than
+       bytes only when the end of the compressed payload is reached. */
+    std::size_t read(void *buffer, std::size_t bytes) {
+        ZSTD_outBuffer output{buffer, bytes, 0};
+        std::size_t previous_position = 0;
+        while (output.pos < output.size) {
+            previous_position = output.pos;
+            const size_t result = ZSTD_decompressStream(decompression_stream_,
+                                                        &output, &input_);
+            if (ZSTD_isError(result)) {
+                raise_format_error("ZSTD_decompressStream() error : %s",
+                                   ZSTD_getErrorName(result));
+            }
+            if (input_.pos == input_.size && output.pos == previous_position) {
+                /* 0 once the last frame is decoded and flushed */
+                if (result != 0) {
+                    raise_format_error("zstd payload ends within a frame");
+                }
+                break;
+            }
+        }
+        return output.pos;
+    }
+
+    ~ZstdDecompressionStream() { ZSTD_freeDStream(decompression_stream_); }
+
+  private:
+    ZSTD_inBuffer input_;
+    ZSTD_DStream *decompression_stream_;
+};
+
+#endif /* PROMISEDYNTRACER_ZSTD_DECOMPRESSION_STREAM_H */
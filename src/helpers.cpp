@@ -3,8 +3,44 @@
 #include "lookup.h"
 #include "utilities.h"
 #include <cassert>
+#include <cinttypes>
 #include <sstream>
 
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+#if !defined(DYNTRACE_PROMISE_ID) || !defined(SET_DYNTRACE_PROMISE_ID)
+#error "DYNTRACE_PROMISE_ID_FIELD needs an R-dyntrace with a promise id field"
+#endif
+
+/* The id field of a promise holds a stamp. Its top 16 bits are the session
+   of the tracer that stamped it, so that the stamps of promises outliving
+   a tracer are not taken for ids by the next one, and its low 48 bits are
+   the id. R-dyntrace zeroes the field of new promises, and no stamp is 0. */
+static const int PROMISE_STAMP_ID_BITS = 48;
+
+static std::uint64_t make_promise_stamp(dyntracer_t *dyntracer,
+                                        prom_id_t prom_id) {
+    const std::uint64_t id_mask =
+        (std::uint64_t{1} << PROMISE_STAMP_ID_BITS) - 1;
+    return (tracer_state(dyntracer).promise_id_session
+            << PROMISE_STAMP_ID_BITS) |
+           (static_cast<std::uint64_t>(prom_id) & id_mask);
+}
+
+/* returns false if the promise has no stamp of this tracer */
+static bool read_promise_stamp(dyntracer_t *dyntracer, SEXP promise,
+                               prom_id_t &prom_id) {
+    std::uint64_t stamp =
+        static_cast<std::uint64_t>(DYNTRACE_PROMISE_ID(promise));
+    if ((stamp >> PROMISE_STAMP_ID_BITS) !=
+        tracer_state(dyntracer).promise_id_session)
+        return false;
+    /* sign extend the id, negative ids are promises created before tracing */
+    prom_id = static_cast<prom_id_t>(stamp << (64 - PROMISE_STAMP_ID_BITS)) >>
+              (64 - PROMISE_STAMP_ID_BITS);
+    return true;
+}
+#endif
+
 rid_t get_sexp_address(SEXP e) { return (rid_t)e; }
 
 prom_id_t get_promise_id(dyntracer_t *dyntracer, SEXP promise) {
@@ -15,6 +51,12 @@ prom_id_t get_promise_id(dyntracer_t *dyntracer, SEXP promise) {
     if (TYPEOF(promise) != PROMSXP)
         return RID_INVALID;
 
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+    prom_id_t prom_id;
+    if (read_promise_stamp(dyntracer, promise, prom_id))
+        return prom_id;
+    return make_promise_id(dyntracer, promise, true);
+#else
     // A new promise is always created for each argument.
     // Even if the argument is already a promise passed from the caller, it gets
     // re-wrapped.
@@ -26,13 +68,13 @@ prom_id_t get_promise_id(dyntracer_t *dyntracer, SEXP promise) {
     } else {
         return make_promise_id(dyntracer, promise, true);
     }
+#endif
 }
 
 prom_id_t make_promise_id(dyntracer_t *dyntracer, SEXP promise, bool negative) {
     if (promise == R_NilValue)
         return RID_INVALID;
 
-    prom_addr_t prom_addr = get_sexp_address(promise);
     prom_id_t prom_id;
 
     if (negative) {
@@ -41,7 +83,11 @@ prom_id_t make_promise_id(dyntracer_t *dyntracer, SEXP promise, bool negative) {
         prom_id = tracer_state(dyntracer).prom_id_counter++;
     }
 
-    tracer_state(dyntracer).promise_ids[prom_addr] = prom_id;
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+    SET_DYNTRACE_PROMISE_ID(promise, make_promise_stamp(dyntracer, prom_id));
+#else
+    tracer_state(dyntracer).promise_ids[get_sexp_address(promise)] = prom_id;
+#endif
 
     // auto &already_inserted_negative_promises =
     //     tracer_state(dyntracer).already_inserted_negative_promises;
@@ -50,50 +96,71 @@ prom_id_t make_promise_id(dyntracer_t *dyntracer, SEXP promise, bool negative) {
     return prom_id;
 }
 
-string get_function_definition(dyntracer_t *dyntracer, const SEXP function) {
-    auto &definitions = tracer_state(dyntracer).function_definitions;
-    auto it = definitions.find(function);
-    if (it != definitions.end()) {
+/* Functions are deparsed and hashed only the first time they are seen.
+   After that, their identity is a single lookup by address until
+   gc_closure_unmark removes them. */
+const function_t &get_function(dyntracer_t *dyntracer, const SEXP function) {
+    auto &functions = tracer_state(dyntracer).functions;
+    auto it = functions.find(function);
+    if (it != functions.end()) {
 #ifdef RDT_DEBUG
         string test = get_expression(function);
-        if (it->second.compare(test) != 0) {
+        if (it->second.definition.compare(test) != 0) {
             cout << "Function definitions are wrong.";
         }
 #endif
         return it->second;
-    } else {
-        string definition = get_expression(function);
-        tracer_state(dyntracer).function_definitions[function] = definition;
-        return definition;
     }
+    string definition = get_expression(function);
+    fn_index_t fn_index = get_function_index(dyntracer, definition);
+    return functions
+        .try_emplace(function, tracer_state(dyntracer).function_ids[fn_index],
+                     fn_index, std::move(definition))
+        .first->second;
 }
 
-void remove_function_definition(dyntracer_t *dyntracer, const SEXP function) {
-    auto &definitions = tracer_state(dyntracer).function_definitions;
-    auto it = definitions.find(function);
-    if (it != definitions.end())
-        tracer_state(dyntracer).function_definitions.erase(it);
+void remove_function(dyntracer_t *dyntracer, const SEXP function) {
+    tracer_state(dyntracer).functions.erase(function);
 }
 
-fn_id_t get_function_id(dyntracer_t *dyntracer,
-                        const string &function_definition, bool builtin) {
+fn_index_t get_function_index(dyntracer_t *dyntracer,
+                              const string &function_definition) {
     fn_key_t definition(function_definition);
 
-    auto &function_ids = tracer_state(dyntracer).function_ids;
-    auto it = function_ids.find(definition);
+    auto &function_indices = tracer_state(dyntracer).function_indices;
+    auto it = function_indices.find(definition);
 
-    if (it != function_ids.end()) {
+    if (it != function_indices.end()) {
         return it->second;
     } else {
         /*Use hash on the function body to compute a unique (hopefully) id
          for each function.*/
 
-        fn_id_t fn_id = compute_hash(definition.c_str());
-        tracer_state(dyntracer).function_ids[definition] = fn_id;
-        return fn_id;
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
+        fn_id_t fn_id = compute_legacy_hash(definition.c_str());
+#else
+        fn_id_t fn_id = compute_hash(definition.data(), definition.size());
+#endif
+        auto &function_ids = tracer_state(dyntracer).function_ids;
+        fn_index_t fn_index = static_cast<fn_index_t>(function_ids.size());
+        function_ids.push_back(std::move(fn_id));
+        function_indices[definition] = fn_index;
+        return fn_index;
     }
 }
 
+fn_id_t get_function_id(dyntracer_t *dyntracer,
+                        const string &function_definition, bool builtin) {
+    return tracer_state(dyntracer)
+        .function_ids[get_function_index(dyntracer, function_definition)];
+}
+
+string fn_id_to_string(std::uint64_t fn_id) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, fn_id);
+    return string(buffer);
+}
+
 bool register_inserted_function(dyntracer_t *dyntracer, fn_id_t id) {
     auto &already_inserted_functions =
         tracer_state(dyntracer).already_inserted_functions;
@@ -124,21 +191,19 @@ call_id_t make_funcall_id(dyntracer_t *dyntracer, SEXP function) {
 
 // FIXME use general parent function by type instead.
 prom_id_t get_parent_promise(dyntracer_t *dyntracer) {
-    for (std::vector<stack_event_t>::reverse_iterator iterator =
-             tracer_state(dyntracer).full_stack.rbegin();
-         iterator != tracer_state(dyntracer).full_stack.rend(); ++iterator) {
-        if (iterator->type == stack_type::PROMISE)
-            return iterator->promise_id;
-    }
+    const ExecutionStack &stack = tracer_state(dyntracer).full_stack;
+    int index = stack.last_index(stack_type::PROMISE);
+    if (index >= 0)
+        return stack[index].promise_id;
     return 0; // FIXME should return a special value or something
 }
 
 size_t get_no_of_ancestor_promises_on_stack(dyntracer_t *dyntracer) {
     size_t result = 0;
-    vector<stack_event_t> &stack = tracer_state(dyntracer).full_stack;
-    for (auto it = stack.begin(); it != stack.end(); ++it) {
-        if (it->type == stack_type::PROMISE)
-            result++;
+    const ExecutionStack &stack = tracer_state(dyntracer).full_stack;
+    for (int index = stack.last_index(stack_type::PROMISE); index >= 0;
+         index = stack.previous_index(index, stack_type::PROMISE)) {
+        result++;
     }
     return result;
 }
@@ -1,4 +1,5 @@
 #include "table.h"
+#include "trace.h"
 #include "tracer.h"
 #include <R_ext/Rdynload.h>
 #include <R_ext/Visibility.h>
@@ -8,10 +9,11 @@ extern "C" {
 #endif
 
 static const R_CallMethodDef CallEntries[] = {
-    {"create_dyntracer", (DL_FUNC)&create_dyntracer, 8},
+    {"create_dyntracer", (DL_FUNC)&create_dyntracer, 12},
     {"destroy_dyntracer", (DL_FUNC)&destroy_dyntracer, 1},
-    {"write_data_table", (DL_FUNC)&write_data_table, 5},
-    {"read_data_table", (DL_FUNC)&read_data_table, 3},
+    {"write_data_table", (DL_FUNC)&write_data_table, 6},
+    {"read_data_table", (DL_FUNC)&read_data_table, 7},
+    {"decode_trace", (DL_FUNC)&decode_trace, 2},
     {NULL, NULL, 0}};
 
 void attribute_visible R_init_promisedyntracer(DllInfo *dll) {
@@ -31,6 +31,7 @@ void dyntrace_exit(dyntracer_t *dyntracer, SEXP expression, SEXP environment,
             tracer_state(dyntracer).full_stack.size());
         tracer_state(dyntracer).full_stack.clear();
     }
+    tracer_state(dyntracer).closure_arguments.clear();
 
     debug_serializer(dyntracer).serialize_finish_trace();
 
@@ -40,6 +41,19 @@ void dyntrace_exit(dyntracer_t *dyntracer, SEXP expression, SEXP environment,
 
     MAIN_TIMER_END_SEGMENT(END_ANALYSIS);
 
+    /* after the analyses, so that metadata.csv has their timer rows */
+    if (tracer_context(dyntracer).get_analysis_switch().metadata) {
+        MetadataAnalysis(tracer_state(dyntracer), tracer_output_dir(dyntracer))
+            .end(dyntracer);
+    }
+
+#ifdef DYNTRACE_COUNT_EVENTS
+    std::ofstream events_file{tracer_output_dir(dyntracer) + "/EVENTS"};
+    events_file << "event_count=" << tracer_state(dyntracer).event_counter
+                << std::endl;
+    events_file.close();
+#endif
+
     if (error) {
         std::ofstream error_file{tracer_output_dir(dyntracer) + "/ERROR"};
         error_file << "ERROR";
@@ -64,9 +78,11 @@ void closure_entry(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
     stack_event_t stack_elem;
     stack_elem.type = stack_type::CALL;
     stack_elem.call_id = info.call_id;
-    stack_elem.function_info.function_id = info.fn_id;
-    stack_elem.function_info.type = function_type::CLOSURE;
+    stack_elem.function_index = info.fn_index;
+    stack_elem.fn_type = function_type::CLOSURE;
     stack_elem.enclosing_environment = info.call_ptr;
+    stack_elem.sampled = sampler(dyntracer).enter_closure(
+        tracer_state(dyntracer).full_stack, info.fn_id);
     tracer_state(dyntracer).full_stack.push_back(stack_elem);
 
     MAIN_TIMER_END_SEGMENT(FUNCTION_ENTRY_STACK);
@@ -79,36 +95,38 @@ void closure_entry(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
 
     tracer_serializer(dyntracer).serialize(
         TraceSerializer::OPCODE_FUNCTION_BEGIN, sexptype_to_string(CLOSXP),
-        info.fn_id, info.call_id,
+        fn_id_field_t{info.fn_id}, info.call_id,
         tracer_state(dyntracer).to_environment_id(rho));
 
     auto &fresh_promises = tracer_state(dyntracer).fresh_promises;
     bool exists = false; // dummy variable, only passed along to to_variable_id
     // Associate promises with call ID
-    for (auto argument : info.arguments) {
+    for (const auto &argument : info.arguments) {
         auto &promise = argument.promise_id;
         // if promise environment is same as the caller's environment, then
         // serialize this promise as it is a default argument.
 
         debug_serializer(dyntracer).serialize_promise_argument_type(promise);
 
-        auto it = fresh_promises.find(promise);
-        if (it != fresh_promises.end()) {
+        if (fresh_promises.erase(promise)) {
             tracer_state(dyntracer).promise_origin[promise] = info.call_id;
-            fresh_promises.erase(it);
         }
 
         if (argument.parameter_mode == parameter_mode_t::DEFAULT ||
             argument.parameter_mode == parameter_mode_t::CUSTOM) {
             tracer_serializer(dyntracer).serialize(
-                TraceSerializer::OPCODE_ARGUMENT_PROMISE_ASSOCIATE, info.fn_id,
-                info.call_id, argument.formal_parameter_position,
-                tracer_state(dyntracer).to_variable_id(argument.name, rho,
+                TraceSerializer::OPCODE_ARGUMENT_PROMISE_ASSOCIATE,
+                fn_id_field_t{info.fn_id}, info.call_id,
+                argument.formal_parameter_position,
+                tracer_state(dyntracer).to_variable_id(argument.symbol, rho,
                                                        exists),
                 argument.name, argument.promise_id);
         }
     }
 
+    tracer_state(dyntracer).closure_arguments.push_back(
+        std::move(info.arguments));
+
     MAIN_TIMER_END_SEGMENT(FUNCTION_ENTRY_WRITE_TRACE);
 }
 
@@ -144,6 +162,8 @@ void closure_exit(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
     tracer_serializer(dyntracer).serialize(
         TraceSerializer::OPCODE_FUNCTION_FINISH, info.call_id, false);
 
+    sampler(dyntracer).restore(tracer_state(dyntracer).full_stack);
+
     MAIN_TIMER_END_SEGMENT(FUNCTION_EXIT_WRITE_TRACE);
 }
 
@@ -204,9 +224,10 @@ void print_entry_info(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
     stack_event_t stack_elem;
     stack_elem.type = stack_type::CALL;
     stack_elem.call_id = info.call_id;
-    stack_elem.function_info.function_id = info.fn_id;
-    stack_elem.function_info.type = info.fn_type;
+    stack_elem.function_index = info.fn_index;
+    stack_elem.fn_type = info.fn_type;
     stack_elem.enclosing_environment = info.call_ptr;
+    stack_elem.sampled = sampler(dyntracer).is_sampled();
     tracer_state(dyntracer).full_stack.push_back(stack_elem);
 #endif
 
@@ -221,7 +242,7 @@ void print_entry_info(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
         TraceSerializer::OPCODE_FUNCTION_BEGIN,
         sexptype_to_string(info.fn_type == function_type::SPECIAL ? SPECIALSXP
                                                                   : BUILTINSXP),
-        info.fn_id, info.call_id,
+        fn_id_field_t{info.fn_id}, info.call_id,
         tracer_state(dyntracer).to_environment_id(rho));
 #endif
 
@@ -269,6 +290,8 @@ void print_exit_info(dyntracer_t *dyntracer, const SEXP call, const SEXP op,
 #ifndef RDT_IGNORE_SPECIALS_AND_BUILTINS
     tracer_serializer(dyntracer).serialize(
         TraceSerializer::OPCODE_FUNCTION_FINISH, info.call_id, false);
+
+    sampler(dyntracer).restore(tracer_state(dyntracer).full_stack);
 #endif
 
     MAIN_TIMER_END_SEGMENT(BUILTIN_EXIT_WRITE_TRACE);
@@ -333,6 +356,7 @@ void promise_force_entry(dyntracer_t *dyntracer, const SEXP promise) {
         tracer_state(dyntracer)
             .full_stack.back()
             .enclosing_environment; // FIXME necessary?
+    stack_elem.sampled = sampler(dyntracer).is_sampled();
     tracer_state(dyntracer).full_stack.push_back(stack_elem);
 
     MAIN_TIMER_END_SEGMENT(FORCE_PROMISE_ENTRY_STACK);
@@ -376,6 +400,8 @@ void promise_force_exit(dyntracer_t *dyntracer, const SEXP promise) {
     tracer_serializer(dyntracer).serialize(
         TraceSerializer::OPCODE_PROMISE_FINISH, info.prom_id, false);
 
+    sampler(dyntracer).restore(tracer_state(dyntracer).full_stack);
+
     MAIN_TIMER_END_SEGMENT(FORCE_PROMISE_EXIT_WRITE_TRACE);
 
     debug_serializer(dyntracer).serialize_force_promise_exit(info);
@@ -513,7 +539,6 @@ void gc_unmark(dyntracer_t *dyntracer, const SEXP expression) {
 void gc_promise_unmark(dyntracer_t *dyntracer, const SEXP promise) {
     MAIN_TIMER_RESET();
 
-    prom_addr_t addr = get_sexp_address(promise);
     prom_id_t id = get_promise_id(dyntracer, promise);
     auto &promise_origin = tracer_state(dyntracer).promise_origin;
 
@@ -523,14 +548,13 @@ void gc_promise_unmark(dyntracer_t *dyntracer, const SEXP promise) {
 
     MAIN_TIMER_END_SEGMENT(GC_PROMISE_UNMARKED_ANALYSIS);
 
-    auto iter = promise_origin.find(id);
-    if (iter != promise_origin.end()) {
-        // If this is one of our traced promises,
-        // delete it from origin map because it is ready to be GCed
-        promise_origin.erase(iter);
-    }
+    // If this is one of our traced promises,
+    // delete it from origin map because it is ready to be GCed
+    promise_origin.erase(id);
 
-    tracer_state(dyntracer).promise_ids.erase(addr);
+#ifndef DYNTRACE_PROMISE_ID_FIELD
+    tracer_state(dyntracer).promise_ids.erase(get_sexp_address(promise));
+#endif
 
     MAIN_TIMER_END_SEGMENT(GC_PROMISE_UNMARKED_RECORD_KEEPING);
 }
@@ -538,7 +562,7 @@ void gc_promise_unmark(dyntracer_t *dyntracer, const SEXP promise) {
 void gc_closure_unmark(dyntracer_t *dyntracer, const SEXP function) {
     MAIN_TIMER_RESET();
 
-    remove_function_definition(dyntracer, function);
+    remove_function(dyntracer, function);
 
     MAIN_TIMER_END_SEGMENT(GC_FUNCTION_UNMARKED_RECORD_KEEPING);
 }
@@ -589,16 +613,15 @@ void new_environment(dyntracer_t *dyntracer, const SEXP rho) {
     stack_event_t event = get_last_on_stack_by_type(
         tracer_state(dyntracer).full_stack, stack_type::CALL);
     fn_id_t fn_id = event.type == stack_type::NONE
-                        ? compute_hash("")
-                        : event.function_info.function_id;
+                        ? get_function_id(dyntracer, "")
+                        : tracer_state(dyntracer)
+                              .function_ids[event.function_index];
 
-    env_id_t env_id = tracer_state(dyntracer).environment_id_counter++;
+    env_id_t env_id = tracer_state(dyntracer).create_environment(rho);
 
     MAIN_TIMER_END_SEGMENT(NEW_ENVIRONMENT_RECORDER);
 
     debug_serializer(dyntracer).serialize_new_environment(env_id, fn_id);
-    tracer_state(dyntracer).environments[rho] =
-        std::pair<env_id_t, unordered_map<string, var_id_t>>(env_id, {});
 
     tracer_serializer(dyntracer).serialize(
         TraceSerializer::OPCODE_ENVIRONMENT_CREATE, env_id);
@@ -612,6 +635,7 @@ void context_entry(dyntracer_t *dyntracer, const RCNTXT *cptr) {
     stack_event_t event;
     event.context_id = (rid_t)cptr;
     event.type = stack_type::CONTEXT;
+    event.sampled = sampler(dyntracer).is_sampled();
     tracer_state(dyntracer).full_stack.push_back(event);
     debug_serializer(dyntracer).serialize_begin_ctxt(cptr);
 
@@ -635,6 +659,8 @@ void context_jump(dyntracer_t *dyntracer, const RCNTXT *cptr,
     MAIN_TIMER_END_SEGMENT(CONTEXT_JUMP_ANALYSIS);
 
     debug_serializer(dyntracer).serialize_unwind(info);
+
+    sampler(dyntracer).restore(tracer_state(dyntracer).full_stack);
 }
 
 void context_exit(dyntracer_t *dyntracer, const RCNTXT *cptr) {
@@ -647,11 +673,14 @@ void context_exit(dyntracer_t *dyntracer, const RCNTXT *cptr) {
         dyntrace_log_warning("Context trying to remove context %d from full "
                              "stack, but %d is on top of stack.",
                              ((rid_t)cptr), event.context_id);
+    sampler(dyntracer).restore(tracer_state(dyntracer).full_stack);
     debug_serializer(dyntracer).serialize_end_ctxt(cptr);
 
     MAIN_TIMER_END_SEGMENT(CONTEXT_EXIT_STACK);
 }
 
+/* Only sampled frames are written to the trace and passed on to the
+   analyses. */
 void adjust_stacks(dyntracer_t *dyntracer, unwind_info_t &info) {
 
     while (!tracer_state(dyntracer).full_stack.empty()) {
@@ -659,20 +688,28 @@ void adjust_stacks(dyntracer_t *dyntracer, unwind_info_t &info) {
 
         // if (info.jump_target == element.enclosing_environment)
         //    break;
-        if (element.type == stack_type::CONTEXT)
+        if (element.type == stack_type::CONTEXT) {
             if (info.jump_context == element.context_id)
                 break;
-            else
+            else if (element.sampled)
                 info.unwound_frames.push_back(element);
-        else if (element.type == stack_type::CALL) {
-            tracer_serializer(dyntracer).serialize(
-                TraceSerializer::OPCODE_FUNCTION_FINISH, element.call_id, true);
-            info.unwound_frames.push_back(element);
+        } else if (element.type == stack_type::CALL) {
+            if (element.sampled) {
+                tracer_serializer(dyntracer).serialize(
+                    TraceSerializer::OPCODE_FUNCTION_FINISH, element.call_id,
+                    true);
+                info.unwound_frames.push_back(element);
+            }
+            if (element.fn_type == function_type::CLOSURE &&
+                !tracer_state(dyntracer).closure_arguments.empty())
+                tracer_state(dyntracer).closure_arguments.pop_back();
         } else if (element.type == stack_type::PROMISE) {
-            tracer_serializer(dyntracer).serialize(
-                TraceSerializer::OPCODE_PROMISE_FINISH, element.promise_id,
-                true);
-            info.unwound_frames.push_back(element);
+            if (element.sampled) {
+                tracer_serializer(dyntracer).serialize(
+                    TraceSerializer::OPCODE_PROMISE_FINISH, element.promise_id,
+                    true);
+                info.unwound_frames.push_back(element);
+            }
         } else /* if (element.type == stack_type::NONE) */
             dyntrace_log_error("NONE object found on tracer's full stack.");
 
@@ -681,7 +718,7 @@ void adjust_stacks(dyntracer_t *dyntracer, unwind_info_t &info) {
 }
 
 void environment_action(dyntracer_t *dyntracer, const SEXP symbol, SEXP value,
-                        const SEXP rho, const std::string &action) {
+                        const SEXP rho, TraceSerializer::opcode_t action) {
     bool exists = true;
     prom_id_t promise_id = tracer_state(dyntracer).enclosing_promise_id();
     env_id_t environment_id = tracer_state(dyntracer).to_environment_id(rho);
@@ -699,20 +736,22 @@ void environment_action(dyntracer_t *dyntracer, const SEXP symbol, SEXP value,
             variable_id, CHAR(PRINTNAME(symbol)), environment_id);
     }
 
-    debug_serializer(dyntracer).serialize_variable_action(promise_id,
-                                                          variable_id, action);
+    const std::string &action_name = TraceSerializer::opcode_to_string(action);
 
-    std::string action_id = action + " " + std::to_string(variable_id);
+    debug_serializer(dyntracer).serialize_variable_action(
+        promise_id, variable_id, action_name);
+
+    std::string action_id = action_name + " " + std::to_string(variable_id);
     debug_serializer(dyntracer).serialize_interference_information(action_id);
 
     if (action == TraceSerializer::OPCODE_ENVIRONMENT_REMOVE) {
-        tracer_serializer(dyntracer).serialize(
-            action, tracer_state(dyntracer).to_environment_id(rho), variable_id,
-            CHAR(PRINTNAME(symbol)));
+        tracer_serializer(dyntracer).serialize(action, environment_id,
+                                               variable_id,
+                                               symbol_field_t{symbol});
     } else {
         tracer_serializer(dyntracer).serialize(
-            action, tracer_state(dyntracer).to_environment_id(rho), variable_id,
-            CHAR(PRINTNAME(symbol)), value_type_to_string(value));
+            action, environment_id, variable_id, symbol_field_t{symbol},
+            value_type_to_string(value));
     }
 
     MAIN_TIMER_END_SEGMENT(ENVIRONMENT_ACTION_WRITE_TRACE);
@@ -11,6 +11,7 @@ void update_closure_argument(closure_info_t &info, dyntracer_t *dyntracer,
     SEXPTYPE arg_value_type = TYPEOF(arg_value);
     SEXPTYPE arg_name_type = TYPEOF(arg_name);
 
+    argument.symbol = arg_name;
     if (arg_name != R_NilValue) {
         argument.name = string(get_name(arg_name));
     } else {
@@ -99,23 +100,35 @@ void update_closure_arguments(closure_info_t &info, dyntracer_t *dyntracer,
     info.formal_parameter_count = formal_parameter_position;
 }
 
+/* namespace qualified name of the closure, if available */
+static string get_qualified_name(const SEXP call, const SEXP op) {
+    const char *name = get_name(call);
+    const char *ns = get_ns_name(op);
+    if (ns) {
+        return string(ns) + "::" + check_string(name);
+    }
+    return name == NULL ? string() : string(name);
+}
+
 closure_info_t function_entry_get_info(dyntracer_t *dyntracer, const SEXP call,
                                        const SEXP op, const SEXP args,
                                        const SEXP rho) {
     RECORDER_TIMER_RESET();
     closure_info_t info;
-
-    const char *name = get_name(call);
-    const char *ns = get_ns_name(op);
+    const call_info_fields_t fields =
+        tracer_context(dyntracer).get_call_info_fields();
 
     info.fn_compiled = is_byte_compiled(op);
     info.fn_type = function_type::CLOSURE;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_OTHER);
 
-    info.fn_definition = get_function_definition(dyntracer, op);
+    const function_t &function = get_function(dyntracer, op);
+    if (fields & CALL_INFO_DEFINITION)
+        info.fn_definition = function.definition;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_DEFINITION);
 
-    info.fn_id = get_function_id(dyntracer, info.fn_definition);
+    info.fn_id = function.fn_id;
+    info.fn_index = function.fn_index;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_FUNCTION_ID);
 
     info.fn_addr = op;
@@ -130,23 +143,23 @@ closure_info_t function_entry_get_info(dyntracer_t *dyntracer, const SEXP call,
     info.parent_call_id = event.type == stack_type::NONE ? 0 : event.call_id;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_PARENT_ID);
 
-    info.definition_location = get_definition_location_cpp(op);
-    info.callsite_location = get_callsite_cpp(1);
+    if (fields & CALL_INFO_LOCATION) {
+        info.definition_location = get_definition_location_cpp(op);
+        info.callsite_location = get_callsite_cpp(1);
+    }
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_LOCATION);
 
-    void (*probe)(dyntracer_t *, SEXP);
-    probe = dyntrace_active_dyntracer->probe_promise_expression_lookup;
-    dyntrace_active_dyntracer->probe_promise_expression_lookup = NULL;
-    info.call_expression = get_expression(call);
+    if (fields & CALL_INFO_EXPRESSION) {
+        void (*probe)(dyntracer_t *, SEXP);
+        probe = dyntrace_active_dyntracer->probe_promise_expression_lookup;
+        dyntrace_active_dyntracer->probe_promise_expression_lookup = NULL;
+        info.call_expression = get_expression(call);
+        dyntrace_active_dyntracer->probe_promise_expression_lookup = probe;
+    }
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_EXPRESSION);
 
-    dyntrace_active_dyntracer->probe_promise_expression_lookup = probe;
-    if (ns) {
-        info.name = string(ns) + "::" + check_string(name);
-    } else {
-        if (name != NULL)
-            info.name = name;
-    }
+    if (fields & CALL_INFO_NAME)
+        info.name = get_qualified_name(call, op);
     RECORDER_TIMER_END_SEGMENT(FUNCTION_ENTRY_RECORDER_NAME);
 
     update_closure_arguments(info, dyntracer, info.call_id, FORMALS(op),
@@ -165,17 +178,19 @@ closure_info_t function_exit_get_info(dyntracer_t *dyntracer, const SEXP call,
                                       const SEXP rho, const SEXP retval) {
     RECORDER_TIMER_RESET();
     closure_info_t info;
-
-    const char *name = get_name(call);
-    const char *ns = get_ns_name(op);
+    const call_info_fields_t fields =
+        tracer_context(dyntracer).get_call_info_fields();
 
     info.fn_compiled = is_byte_compiled(op);
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_OTHER);
 
-    info.fn_definition = get_function_definition(dyntracer, op);
+    const function_t &function = get_function(dyntracer, op);
+    if (fields & CALL_INFO_DEFINITION)
+        info.fn_definition = function.definition;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_DEFINITION);
 
-    info.fn_id = get_function_id(dyntracer, info.fn_definition);
+    info.fn_id = function.fn_id;
+    info.fn_index = function.fn_index;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_FUNCTION_ID);
 
     info.fn_addr = op;
@@ -188,24 +203,25 @@ closure_info_t function_exit_get_info(dyntracer_t *dyntracer, const SEXP call,
     info.fn_type = function_type::CLOSURE;
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_OTHER);
 
-    info.definition_location = get_definition_location_cpp(op);
-    info.callsite_location = get_callsite_cpp(0);
+    if (fields & CALL_INFO_LOCATION) {
+        info.definition_location = get_definition_location_cpp(op);
+        info.callsite_location = get_callsite_cpp(0);
+    }
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_LOCATION);
 
-    if (ns) {
-        info.name = string(ns) + "::" + check_string(name);
-    } else {
-        if (name != NULL)
-            info.name = name;
-    }
+    if (fields & CALL_INFO_NAME)
+        info.name = get_qualified_name(call, op);
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_NAME);
 
-    update_closure_arguments(info, dyntracer, info.call_id, FORMALS(op),
-                             FRAME(rho), rho);
+    /* reuse the arguments captured on entry instead of walking the frame */
+    auto &closure_arguments = tracer_state(dyntracer).closure_arguments;
+    if (!closure_arguments.empty()) {
+        info.arguments = std::move(closure_arguments.back());
+        closure_arguments.pop_back();
+    }
+    info.formal_parameter_count = Rf_length(FORMALS(op));
     RECORDER_TIMER_END_SEGMENT(FUNCTION_EXIT_RECORDER_ARGUMENTS);
 
-    info.fn_definition = get_expression(op);
-
     stack_event_t parent_call = get_from_back_of_stack_by_type(
         tracer_state(dyntracer).full_stack, stack_type::CALL, 1);
     info.parent_call_id =
@@ -226,20 +242,28 @@ builtin_info_t builtin_entry_get_info(dyntracer_t *dyntracer, const SEXP call,
                                       const SEXP op, const SEXP rho,
                                       function_type fn_type) {
     builtin_info_t info;
-    const char *name = get_name(call);
-    if (name != NULL)
-        info.name = name;
-    info.fn_definition = get_function_definition(dyntracer, op);
-    info.fn_id = get_function_id(dyntracer, info.fn_definition, true);
+    const call_info_fields_t fields =
+        tracer_context(dyntracer).get_call_info_fields();
+    if (fields & CALL_INFO_NAME) {
+        const char *name = get_name(call);
+        if (name != NULL)
+            info.name = name;
+    }
+    const function_t &function = get_function(dyntracer, op);
+    if (fields & CALL_INFO_DEFINITION)
+        info.fn_definition = function.definition;
+    info.fn_id = function.fn_id;
+    info.fn_index = function.fn_index;
     info.fn_addr = op;
-    info.name = info.name;
     info.fn_type = fn_type;
     info.fn_compiled = is_byte_compiled(op);
     stack_event_t elem = get_last_on_stack_by_type(
         tracer_state(dyntracer).full_stack, stack_type::CALL);
     info.parent_call_id = elem.type == stack_type::NONE ? 0 : elem.call_id;
-    info.definition_location = get_definition_location_cpp(op);
-    info.callsite_location = get_callsite_cpp(0);
+    if (fields & CALL_INFO_LOCATION) {
+        info.definition_location = get_definition_location_cpp(op);
+        info.callsite_location = get_callsite_cpp(0);
+    }
     info.call_ptr = get_sexp_address(rho);
     info.call_id = make_funcall_id(dyntracer, op);
 
@@ -255,23 +279,30 @@ builtin_info_t builtin_exit_get_info(dyntracer_t *dyntracer, const SEXP call,
                                      const SEXP op, const SEXP rho,
                                      function_type fn_type, const SEXP retval) {
     builtin_info_t info;
+    const call_info_fields_t fields =
+        tracer_context(dyntracer).get_call_info_fields();
 
-    const char *name = get_name(call);
-    if (name != NULL)
-        info.name = name;
-    info.fn_definition = get_function_definition(dyntracer, op);
-    info.fn_id = get_function_id(dyntracer, info.fn_definition, true);
+    if (fields & CALL_INFO_NAME) {
+        const char *name = get_name(call);
+        if (name != NULL)
+            info.name = name;
+    }
+    const function_t &function = get_function(dyntracer, op);
+    if (fields & CALL_INFO_DEFINITION)
+        info.fn_definition = function.definition;
+    info.fn_id = function.fn_id;
+    info.fn_index = function.fn_index;
     info.fn_addr = op;
     stack_event_t elem = get_last_on_stack_by_type(
         tracer_state(dyntracer).full_stack, stack_type::CALL);
 
     info.call_id = elem.type == stack_type::NONE ? 0 : elem.call_id;
-    if (name != NULL)
-        info.name = name;
     info.fn_type = fn_type;
     info.fn_compiled = is_byte_compiled(op);
-    info.definition_location = get_definition_location_cpp(op);
-    info.callsite_location = get_callsite_cpp(0);
+    if (fields & CALL_INFO_LOCATION) {
+        info.definition_location = get_definition_location_cpp(op);
+        info.callsite_location = get_callsite_cpp(0);
+    }
 
     stack_event_t parent_call = get_from_back_of_stack_by_type(
         tracer_state(dyntracer).full_stack, stack_type::CALL, 1);
@@ -422,5 +453,21 @@ void write_configuration(const Context &context, const std::string &filepath) {
     serialize_row("binary", std::to_string(context.is_binary()));
     serialize_row("compression_level",
                   std::to_string(context.get_compression_level()));
+    serialize_row("compression_threads",
+                  std::to_string(context.get_compression_threads()));
+    /* counts of sampled runs are extrapolated by dividing by the rate */
+    const SamplingSwitch &sampling_switch{
+        context.get_sampler().get_sampling_switch()};
+    serialize_row("sampling_mode",
+                  sampling_mode_to_string(sampling_switch.mode));
+    serialize_row("sampling_period", std::to_string(sampling_switch.period));
+    serialize_row("sampling_window", std::to_string(sampling_switch.window));
+    serialize_row("sampling_seed", std::to_string(sampling_switch.seed));
+    serialize_row("sampling_rate", std::to_string(sampling_switch.get_rate()));
+#ifdef DYNTRACE_PROMISE_ID_FIELD
+    serialize_row("promise_id_storage", "field");
+#else
+    serialize_row("promise_id_storage", "map");
+#endif
     serialize_row("GIT_COMMIT_INFO", GIT_COMMIT_INFO);
 }
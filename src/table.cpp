@@ -1,28 +1,36 @@
 #include "table.h"
 #include "BinaryDataTableStream.h"
 #include "TextDataTableStream.h"
+#include "ZstdDecompressionStream.h"
 #include "utilities.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 DataTableStream *create_data_table(const std::string &table_filepath,
                                    const std::vector<std::string> &column_names,
                                    bool truncate, bool binary,
-                                   int compression_level) {
+                                   int compression_level,
+                                   int compression_threads) {
     std::string extension = compression_level == 0 ? "" : ".zst";
     DataTableStream *stream = nullptr;
     if (binary) {
         stream = new BinaryDataTableStream(table_filepath + ".bin" + extension,
                                            column_names, truncate,
-                                           compression_level);
+                                           compression_level,
+                                           compression_threads);
     } else {
-        stream =
-            new TextDataTableStream(table_filepath + ".csv" + extension,
-                                    column_names, truncate, compression_level);
+        stream = new TextDataTableStream(table_filepath + ".csv" + extension,
+                                         column_names, truncate,
+                                         compression_level,
+                                         compression_threads);
     }
     return stream;
 }
 
 SEXP write_data_table(SEXP data_frame, SEXP table_filepath, SEXP truncate,
-                      SEXP binary, SEXP compression_level) {
+                      SEXP binary, SEXP compression_level,
+                      SEXP compression_threads) {
 
     std::size_t column_count = LENGTH(data_frame);
     std::vector<std::string> column_names{column_count, ""};
@@ -52,7 +60,8 @@ SEXP write_data_table(SEXP data_frame, SEXP table_filepath, SEXP truncate,
 
     DataTableStream *stream = create_data_table(
         sexp_to_string(table_filepath), column_names, sexp_to_bool(truncate),
-        sexp_to_bool(binary), sexp_to_int(compression_level));
+        sexp_to_bool(binary), sexp_to_int(compression_level),
+        sexp_to_int(compression_threads));
 
     for (int row_index = 0; row_index < row_count; ++row_index) {
         for (int column_index = 0; column_index < column_count;
@@ -92,6 +101,98 @@ static SEXP read_text_data_table(const std::string &filepath,
     return R_NilValue;
 }
 
+/* Presents the blocks of a binary data table, compressed or not, as a
+   sequence of bytes. Uncompressed blocks are read in place from the mapped
+   file. Compressed blocks are decompressed on demand into a window that only
+   has to be as large as the largest column chunk, so the decompressed table
+   never exists in memory in full. */
+class DataTableInput {
+  public:
+    DataTableInput(const std::string &filepath, const char *data,
+                   std::size_t size, bool compressed)
+        : filepath_{filepath}, current_{data}, end_{data + size},
+          decompression_stream_{nullptr}, buffer_{nullptr}, buffer_size_{0} {
+        if (!compressed) {
+            return;
+        }
+        if (!ZstdDecompressionStream::is_compressed(data, size)) {
+            raise_format_error("rows of %s are not zstd compressed",
+                               filepath.c_str());
+        }
+        decompression_stream_ = new ZstdDecompressionStream(data, size);
+        buffer_size_ = std::max(ZSTD_DStreamOutSize(), WINDOW_SIZE);
+        buffer_ = static_cast<char *>(malloc_or_die(buffer_size_));
+        current_ = end_ = buffer_;
+    }
+
+    /* returns a pointer to the next bytes contiguous bytes of the table */
+    const char *read(std::size_t bytes) {
+        if (static_cast<std::size_t>(end_ - current_) < bytes) {
+            refill_(bytes);
+        }
+        const char *current = current_;
+        current_ += bytes;
+        return current;
+    }
+
+    /* moves past the next bytes bytes of the table without growing the
+       window beyond its current size */
+    void skip(std::size_t bytes) {
+        std::size_t skipped_bytes = 0;
+        while (bytes != 0) {
+            skipped_bytes =
+                buffer_size_ == 0 ? bytes : std::min(bytes, buffer_size_);
+            read(skipped_bytes);
+            bytes -= skipped_bytes;
+        }
+    }
+
+    ~DataTableInput() {
+        delete decompression_stream_;
+        std::free(buffer_);
+    }
+
+  private:
+    void refill_(std::size_t bytes) {
+        if (decompression_stream_ == nullptr) {
+            raise_format_error("unexpected end of table %s",
+                               filepath_.c_str());
+        }
+
+        std::size_t remaining_bytes = end_ - current_;
+
+        if (bytes > buffer_size_) {
+            buffer_size_ = 2 * bytes;
+            char *buffer = static_cast<char *>(malloc_or_die(buffer_size_));
+            std::memcpy(buffer, current_, remaining_bytes);
+            std::free(buffer_);
+            buffer_ = buffer;
+        } else {
+            std::memmove(buffer_, current_, remaining_bytes);
+        }
+
+        remaining_bytes += decompression_stream_->read(
+            buffer_ + remaining_bytes, buffer_size_ - remaining_bytes);
+
+        if (remaining_bytes < bytes) {
+            raise_format_error("unexpected end of table %s",
+                               filepath_.c_str());
+        }
+
+        current_ = buffer_;
+        end_ = buffer_ + remaining_bytes;
+    }
+
+    static constexpr std::size_t WINDOW_SIZE = 1024 * 1024;
+
+    const std::string filepath_;
+    const char *current_;
+    const char *end_;
+    ZstdDecompressionStream *decompression_stream_;
+    char *buffer_;
+    std::size_t buffer_size_;
+};
+
 int parse_integer(const char *buffer, const char **end, std::size_t bytes = 4) {
     int value = 0;
     std::memcpy(&value, buffer, bytes);
@@ -99,20 +200,6 @@ int parse_integer(const char *buffer, const char **end, std::size_t bytes = 4) {
     return value;
 }
 
-double parse_real(const char *buffer, const char **end) {
-    double value = 0.0;
-    std::memcpy(&value, buffer, sizeof(double));
-    *end = buffer + sizeof(double);
-    return value;
-}
-
-int parse_logical(const char *buffer, const char **end) {
-    int value = 0;
-    std::memcpy(&value, buffer, sizeof(bool));
-    *end = buffer + sizeof(bool);
-    return value;
-}
-
 SEXPTYPE parse_sexptype(const char *buffer, const char **end) {
     std::uint32_t value = 0;
     std::memcpy(&value, buffer, sizeof(std::uint32_t));
@@ -120,142 +207,630 @@ SEXPTYPE parse_sexptype(const char *buffer, const char **end) {
     return value;
 }
 
-SEXP parse_character(const char *buffer, const char **end, char **dest,
-                     std::size_t *dest_size) {
-
+std::string parse_string(const char *buffer, const char **end) {
     std::uint32_t size = parse_integer(buffer, end, sizeof(std::uint32_t));
-
-    if (size >= *dest_size) {
-        free(*dest);
-        *dest_size = 2 * size;
-        *dest = static_cast<char *>(malloc_or_die(*dest_size));
-    }
-
-    std::memcpy(*dest, *end, size);
+    std::string value{*end, size};
     *end = *end + size;
-    (*dest)[size] = '\0';
+    return value;
+}
 
-    return mkChar(*dest);
+template <typename T> T parse_value(DataTableInput &input) {
+    T value;
+    std::memcpy(&value, input.read(sizeof(T)), sizeof(T));
+    return value;
 }
 
-struct data_frame_t {
-    SEXP object;
+struct table_header_t {
     std::size_t row_count;
-    std::size_t column_count;
-    std::vector<SEXP> columns;
+    std::vector<std::string> column_names;
     std::vector<DataTableStream::column_type_t> column_types;
 };
 
-static data_frame_t read_header(const char *buffer, const char **end) {
+static table_header_t read_header(const std::string &filepath,
+                                  const char *buffer,
+                                  const char *end_of_buffer,
+                                  const char **end) {
 
-    data_frame_t data_frame{nullptr, 0, 0, {}, {}};
-    std::size_t character_size = 1024 * 1024;
-    char *character_value = static_cast<char *>(malloc(character_size));
+    table_header_t header{0, {}, {}};
+    const std::string &magic = BinaryDataTableStream::MAGIC;
 
-    int row_count = parse_integer(buffer, end);
-    int column_count = parse_integer(*end, end);
+    /* checks that the next bytes bytes of the header are in the file */
+    auto require = [&](const char *position, std::size_t bytes) {
+        if (static_cast<std::size_t>(end_of_buffer - position) < bytes) {
+            raise_format_error("unexpected end of the header of %s",
+                               filepath.c_str());
+        }
+    };
 
-    data_frame.row_count = row_count;
-    data_frame.column_count = column_count;
+    if (buffer == nullptr ||
+        static_cast<std::size_t>(end_of_buffer - buffer) < magic.size() ||
+        magic.compare(0, magic.size(), buffer, magic.size()) != 0) {
+        raise_format_error("%s is not a binary data table", filepath.c_str());
+    }
+    *end = buffer + magic.size();
+
+    require(*end, 3 * sizeof(std::uint32_t));
+    std::uint32_t version =
+        parse_integer(*end, end, sizeof(std::uint32_t));
+    if (version != BinaryDataTableStream::FORMAT_VERSION) {
+        raise_format_error("%s is a binary data table of version %u, "
+                           "expected %u",
+                           filepath.c_str(), version,
+                           BinaryDataTableStream::FORMAT_VERSION);
+    }
 
-    data_frame.object = PROTECT(allocVector(VECSXP, column_count));
-    SEXP column_names = PROTECT(allocVector(STRSXP, column_count));
-    SEXP row_names = PROTECT(allocVector(STRSXP, row_count));
+    header.row_count = parse_integer(*end, end);
+    int column_count = parse_integer(*end, end);
 
-    data_frame.columns.reserve(column_count);
-    data_frame.column_types.reserve(column_count);
+    header.column_names.reserve(column_count);
+    header.column_types.reserve(column_count);
 
     for (int column_index = 0; column_index < column_count; ++column_index) {
-        SEXP name =
-            parse_character(*end, end, &character_value, &character_size);
-        SET_STRING_ELT(column_names, column_index, name);
+        require(*end, sizeof(std::uint32_t));
+        std::uint32_t name_size = 0;
+        std::memcpy(&name_size, *end, sizeof(name_size));
+        require(*end, sizeof(std::uint32_t) + name_size +
+                          2 * sizeof(std::uint32_t));
+        header.column_names.push_back(parse_string(*end, end));
         SEXPTYPE sexptype = parse_sexptype(*end, end);
         uint32_t size = parse_integer(*end, end);
-        data_frame.column_types.push_back({sexptype, size});
-        SEXP column = PROTECT(allocVector(sexptype, row_count));
-        data_frame.columns.push_back(column);
-        SET_VECTOR_ELT(data_frame.object, column_index, column);
+        header.column_types.push_back({sexptype, size});
     }
 
-    for (int row_index = 0; row_index < row_count; ++row_index) {
-        sprintf(character_value, "%d", row_index + 1);
-        SET_STRING_ELT(row_names, row_index, mkChar(character_value));
+    return header;
+}
+
+/* Dictionary of a string column. CHARSXPs are created once per distinct
+   value and shared by all cells holding that value. For factor columns the
+   dictionary becomes the levels. */
+struct string_dictionary_t {
+    /* protected through data_frame_t::dictionaries */
+    SEXP entries;
+    int size;
+    /* maps values to codes, only built for plain chunks of factor columns */
+    std::unordered_map<std::string, int> codes;
+};
+
+struct data_frame_t {
+    SEXP object;
+    std::size_t row_count;
+    bool strings_as_factors;
+    /* column of object for every column of the table, -1 if the column is
+       not selected */
+    std::vector<int> column_slots;
+    std::vector<SEXP> columns;
+    std::vector<string_dictionary_t> string_dictionaries;
+    SEXP dictionaries;
+};
+
+/* allocates a data frame with row_count rows for the selected columns of
+   the table, in the order in which they are selected. All columns are
+   selected if selected_columns is NULL. The data frame and its
+   dictionaries are protected. */
+static data_frame_t create_data_frame(const std::string &filepath,
+                                      const table_header_t &header,
+                                      SEXP selected_columns,
+                                      std::size_t row_count,
+                                      bool strings_as_factors) {
+
+    const std::size_t column_count = header.column_names.size();
+    data_frame_t data_frame{nullptr,
+                            row_count,
+                            strings_as_factors,
+                            std::vector<int>(column_count, -1),
+                            {},
+                            {},
+                            nullptr};
+    std::vector<std::size_t> column_indices;
+
+    if (selected_columns == R_NilValue) {
+        for (std::size_t column_index = 0; column_index < column_count;
+             ++column_index) {
+            column_indices.push_back(column_index);
+        }
+    } else {
+        for (int index = 0; index < LENGTH(selected_columns); ++index) {
+            const char *name = CHAR(STRING_ELT(selected_columns, index));
+            auto iter = std::find(header.column_names.begin(),
+                                  header.column_names.end(), name);
+            if (iter == header.column_names.end()) {
+                raise_format_error("column %s not found in %s", name,
+                                   filepath.c_str());
+            }
+            column_indices.push_back(iter - header.column_names.begin());
+        }
+    }
+
+    data_frame.object = PROTECT(allocVector(VECSXP, column_indices.size()));
+    data_frame.dictionaries =
+        PROTECT(allocVector(VECSXP, column_indices.size()));
+    SEXP column_names = PROTECT(allocVector(STRSXP, column_indices.size()));
+    /* compact representation of row names 1 to row_count */
+    SEXP row_names = PROTECT(allocVector(INTSXP, 2));
+    INTEGER(row_names)[0] = NA_INTEGER;
+    INTEGER(row_names)[1] = -static_cast<int>(row_count);
+
+    data_frame.string_dictionaries.resize(column_indices.size(),
+                                          {R_NilValue, 0, {}});
+
+    for (std::size_t slot = 0; slot < column_indices.size(); ++slot) {
+        const std::size_t column_index = column_indices[slot];
+        if (data_frame.column_slots[column_index] != -1) {
+            raise_format_error("column %s selected more than once",
+                               header.column_names[column_index].c_str());
+        }
+        data_frame.column_slots[column_index] = slot;
+        SET_STRING_ELT(column_names, slot,
+                       mkChar(header.column_names[column_index].c_str()));
+        SEXPTYPE sexptype = header.column_types[column_index].first;
+        if (sexptype == STRSXP) {
+            SEXP entries = allocVector(STRSXP, 16);
+            data_frame.string_dictionaries[slot].entries = entries;
+            SET_VECTOR_ELT(data_frame.dictionaries, slot, entries);
+            sexptype = strings_as_factors ? INTSXP : STRSXP;
+        }
+        SEXP column = allocVector(sexptype, row_count);
+        data_frame.columns.push_back(column);
+        SET_VECTOR_ELT(data_frame.object, slot, column);
     }
 
     setAttrib(data_frame.object, R_RowNamesSymbol, row_names);
     setAttrib(data_frame.object, R_NamesSymbol, column_names);
     setAttrib(data_frame.object, R_ClassSymbol, mkString("data.frame"));
-    free(character_value);
-    UNPROTECT(3);
+    UNPROTECT(2);
     return data_frame;
 }
 
-static SEXP read_binary_data_table(const std::string &filepath,
-                                   int compression_level) {
-    if (compression_level != 0) {
-        return R_NilValue;
+static int add_dictionary_entry(data_frame_t &data_frame, int slot,
+                                SEXP entry) {
+    string_dictionary_t &dictionary = data_frame.string_dictionaries[slot];
+
+    if (dictionary.size == LENGTH(dictionary.entries)) {
+        PROTECT(entry);
+        SEXP entries = allocVector(STRSXP, 2 * dictionary.size);
+        for (int index = 0; index < dictionary.size; ++index) {
+            SET_STRING_ELT(entries, index,
+                           STRING_ELT(dictionary.entries, index));
+        }
+        dictionary.entries = entries;
+        SET_VECTOR_ELT(data_frame.dictionaries, slot, entries);
+        UNPROTECT(1);
     }
 
-    auto const[buf, buffer_size] = map_to_memory(filepath);
-    const char *buffer = static_cast<const char *>(buf);
-    const char *const end_of_buffer = buffer + buffer_size;
-    const char *end = nullptr;
-    data_frame_t data_frame{read_header(buffer, &end)};
-    std::size_t character_size = 1024 * 1024;
-    char *character_value = static_cast<char *>(malloc(character_size));
+    if (!dictionary.codes.empty()) {
+        dictionary.codes.insert({CHAR(entry), dictionary.size});
+    }
+
+    SET_STRING_ELT(dictionary.entries, dictionary.size, entry);
+    return dictionary.size++;
+}
+
+/* returns the code of value in the dictionary, adding it if needed */
+static int intern_dictionary_entry(data_frame_t &data_frame, int slot,
+                                   const char *value, std::uint32_t size) {
+    string_dictionary_t &dictionary = data_frame.string_dictionaries[slot];
+
+    if (dictionary.codes.empty()) {
+        for (int index = 0; index < dictionary.size; ++index) {
+            dictionary.codes.insert(
+                {CHAR(STRING_ELT(dictionary.entries, index)), index});
+        }
+    }
+
+    auto iter = dictionary.codes.find(std::string(value, size));
+    if (iter != dictionary.codes.end()) {
+        return iter->second;
+    }
+    int code = add_dictionary_entry(data_frame, slot, mkCharLen(value, size));
+    dictionary.codes.insert({std::string(value, size), code});
+    return code;
+}
+
+/* copies the first row_count strings of a chunk of chunk_size bytes
+   holding block_row_count strings to rows [row_index, row_index +
+   row_count) of the column in slot. */
+static void read_string_chunk(const std::string &filepath,
+                              std::size_t column_index,
+                              data_frame_t &data_frame, int slot,
+                              const char *chunk, std::size_t chunk_size,
+                              std::size_t row_index,
+                              std::size_t block_row_count,
+                              std::size_t row_count) {
+
+    SEXP column = data_frame.columns[slot];
+    const char *const end_of_chunk = chunk + chunk_size;
+    std::uint8_t encoding = 0;
+    std::uint32_t size = 0;
+
+    /* checks that the next bytes bytes from position are in the chunk */
+    auto require = [&](const char *position, std::size_t bytes) {
+        if (static_cast<std::size_t>(end_of_chunk - position) < bytes) {
+            raise_format_error("string chunk of column %lu in %s is "
+                               "shorter than its contents",
+                               column_index, filepath.c_str());
+        }
+    };
+
+    require(chunk, sizeof(encoding));
+    std::memcpy(&encoding, chunk, sizeof(encoding));
+    chunk += sizeof(encoding);
+
+    if (encoding == BinaryDataTableStream::STRING_ENCODING_PLAIN) {
+        require(chunk, block_row_count * sizeof(std::uint32_t));
+        const char *sizes = chunk;
+        const char *value = chunk + block_row_count * sizeof(std::uint32_t);
+        for (std::size_t index = 0; index < row_count; ++index) {
+            std::memcpy(&size, sizes, sizeof(size));
+            sizes += sizeof(size);
+            require(value, size);
+            if (data_frame.strings_as_factors) {
+                INTEGER(column)
+                [row_index + index] =
+                    intern_dictionary_entry(data_frame, slot, value, size) + 1;
+            } else {
+                SET_STRING_ELT(column, row_index + index,
+                               mkCharLen(value, size));
+            }
+            value += size;
+        }
+        return;
+    }
+
+    if (encoding != BinaryDataTableStream::STRING_ENCODING_DICTIONARY) {
+        raise_format_error("unknown string encoding %d of column %lu in %s",
+                           encoding, column_index, filepath.c_str());
+    }
+
+    require(chunk, sizeof(std::uint32_t));
+    std::uint32_t entry_count = 0;
+    std::memcpy(&entry_count, chunk, sizeof(entry_count));
+    const char *sizes = chunk + sizeof(entry_count);
+    require(sizes, entry_count * sizeof(std::uint32_t));
+    const char *entry = sizes + entry_count * sizeof(std::uint32_t);
+
+    for (std::uint32_t index = 0; index < entry_count; ++index) {
+        std::memcpy(&size, sizes, sizeof(size));
+        sizes += sizeof(size);
+        require(entry, size);
+        add_dictionary_entry(data_frame, slot, mkCharLen(entry, size));
+        entry += size;
+    }
+
+    const string_dictionary_t &dictionary =
+        data_frame.string_dictionaries[slot];
+    const char *codes = entry;
+    std::uint32_t code = 0;
+    require(codes, row_count * sizeof(code));
+
+    for (std::size_t index = 0; index < row_count; ++index) {
+        std::memcpy(&code, codes, sizeof(code));
+        codes += sizeof(code);
+        if (code >= static_cast<std::uint32_t>(dictionary.size)) {
+            raise_format_error("invalid dictionary code %u of column %lu in %s",
+                               code, column_index, filepath.c_str());
+        }
+        if (data_frame.strings_as_factors) {
+            INTEGER(column)[row_index + index] = code + 1;
+        } else {
+            SET_STRING_ELT(column, row_index + index,
+                           STRING_ELT(dictionary.entries, code));
+        }
+    }
+}
+
+static void
+check_column_chunk(const std::string &filepath, std::size_t column_index,
+                   const DataTableStream::column_type_t &column_type,
+                   std::size_t chunk_size, std::size_t block_row_count) {
+    switch (column_type.first) {
+        case LGLSXP:
+        case INTSXP:
+        case REALSXP:
+            break;
+        default:
+            raise_format_error("unhandled column type %u of column %lu in %s",
+                               column_type.first, column_index,
+                               filepath.c_str());
+    }
+
+    if (chunk_size != column_type.second * block_row_count) {
+        raise_format_error(
+            "column %lu of %s has a chunk of %lu bytes for %lu rows",
+            column_index, filepath.c_str(), chunk_size, block_row_count);
+    }
+}
+
+/* copies the first row_count values of a checked column chunk to rows
+   [row_index, row_index + row_count) of the column whose data starts at
+   values. Values that have the same representation as R are copied in one
+   go, others are widened one at a time. This does not call into R and can
+   run on any thread. */
+static void copy_column_chunk(const DataTableStream::column_type_t &column_type,
+                              const char *chunk, void *values,
+                              std::size_t row_index, std::size_t row_count) {
+
+    const std::size_t value_size = column_type.second;
+
+    if (column_type.first == REALSXP) {
+        std::memcpy(static_cast<double *>(values) + row_index, chunk,
+                    row_count * sizeof(double));
+        return;
+    }
+
+    int *int_values = static_cast<int *>(values) + row_index;
+
+    if (value_size == sizeof(int)) {
+        std::memcpy(int_values, chunk, row_count * sizeof(int));
+    } else {
+        for (std::size_t index = 0; index < row_count; ++index) {
+            int_values[index] = parse_integer(chunk, &chunk, value_size);
+        }
+    }
+}
+
+static void *get_column_values(SEXP column) {
+    switch (TYPEOF(column)) {
+        case LGLSXP:
+            return LOGICAL(column);
+        case INTSXP:
+            return INTEGER(column);
+        case REALSXP:
+            return REAL(column);
+        default:
+            return nullptr;
+    }
+}
+
+struct column_chunk_t {
+    const char *data;
+    std::size_t size;
+};
+
+struct block_t {
+    std::size_t row_index;
+    std::size_t row_count;
+    /* number of rows of the block to read */
+    std::size_t read_count;
+    std::vector<column_chunk_t> chunks;
+};
+
+/* locates the column chunks of all blocks holding the rows to be read
+   without reading them. This only works for uncompressed tables whose
+   chunks stay in place in the mapped file. */
+static std::vector<block_t> index_blocks(const std::string &filepath,
+                                         const table_header_t &header,
+                                         const data_frame_t &data_frame,
+                                         DataTableInput &input) {
+    std::vector<block_t> blocks;
+    std::size_t row_index = 0;
 
-    int row_index = 0;
-    int column_index = 0;
     while (row_index < data_frame.row_count) {
-        switch (data_frame.column_types[column_index].first) {
-
-            case LGLSXP:
-                LOGICAL(data_frame.columns[column_index])
-                [row_index] = parse_logical(end, &end);
-                break;
-
-            case INTSXP:
-                INTEGER(data_frame.columns[column_index])
-                [row_index] = parse_integer(
-                    end, &end, data_frame.column_types[column_index].second);
-                break;
-
-            case REALSXP:
-                REAL(data_frame.columns[column_index])
-                [row_index] = parse_real(end, &end);
-                break;
-
-            case STRSXP:
-                SET_STRING_ELT(data_frame.columns[column_index], row_index,
-                               parse_character(end, &end, &character_value,
-                                               &character_size));
-                break;
-
-            default:
-                Rf_error("unhandled column type %d of column %d in %s ",
-                         data_frame.column_types[column_index].first,
-                         column_index, filepath.c_str());
+        block_t block{row_index, parse_value<std::uint32_t>(input), 0, {}};
+
+        if (row_index + block.row_count > header.row_count) {
+            raise_format_error("%s has more rows than the %lu in its header",
+                               filepath.c_str(), header.row_count);
         }
 
-        ++column_index;
-        if (column_index == data_frame.column_count) {
-            column_index = 0;
-            ++row_index;
+        block.read_count =
+            std::min(block.row_count, data_frame.row_count - row_index);
+
+        for (std::size_t column_index = 0;
+             column_index < header.column_names.size(); ++column_index) {
+            std::size_t chunk_size =
+                parse_value<BinaryDataTableStream::block_size_t>(input);
+            if (data_frame.column_slots[column_index] != -1 &&
+                header.column_types[column_index].first != STRSXP) {
+                check_column_chunk(filepath, column_index,
+                                   header.column_types[column_index],
+                                   chunk_size, block.row_count);
+            }
+            block.chunks.push_back({input.read(chunk_size), chunk_size});
         }
+
+        row_index += block.read_count;
+        blocks.push_back(std::move(block));
     }
 
-    UNPROTECT(data_frame.column_count);
-    std::free(character_value);
+    return blocks;
+}
+
+/* Fills the rows of every block from thread_count threads. Fixed width
+   columns are copied by the threads, each taking whole blocks at a time.
+   String columns need mkChar and SET_STRING_ELT, which must not be called
+   concurrently, so they are filled in block order on this thread after the
+   other threads are done. */
+static void read_blocks_in_parallel(const std::string &filepath,
+                                    const table_header_t &header,
+                                    data_frame_t &data_frame,
+                                    const std::vector<block_t> &blocks,
+                                    std::size_t thread_count) {
+    std::vector<void *> column_values;
+    for (SEXP column : data_frame.columns) {
+        column_values.push_back(get_column_values(column));
+    }
+
+    std::atomic<std::size_t> next_block{0};
+
+    auto copy_blocks = [&]() {
+        for (std::size_t block_index = next_block++;
+             block_index < blocks.size(); block_index = next_block++) {
+            const block_t &block = blocks[block_index];
+            for (std::size_t column_index = 0;
+                 column_index < header.column_names.size(); ++column_index) {
+                int slot = data_frame.column_slots[column_index];
+                if (slot == -1 ||
+                    header.column_types[column_index].first == STRSXP) {
+                    continue;
+                }
+                copy_column_chunk(header.column_types[column_index],
+                                  block.chunks[column_index].data,
+                                  column_values[slot], block.row_index,
+                                  block.read_count);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t index = 1; index < thread_count; ++index) {
+        threads.emplace_back(copy_blocks);
+    }
+    copy_blocks();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (const block_t &block : blocks) {
+        for (std::size_t column_index = 0;
+             column_index < header.column_names.size(); ++column_index) {
+            int slot = data_frame.column_slots[column_index];
+            if (slot != -1 &&
+                header.column_types[column_index].first == STRSXP) {
+                read_string_chunk(filepath, column_index, data_frame, slot,
+                                  block.chunks[column_index].data,
+                                  block.chunks[column_index].size,
+                                  block.row_index, block.row_count,
+                                  block.read_count);
+            }
+        }
+    }
+}
+
+/* reads and fills one block at a time, which is the only option for
+   compressed tables as their chunks do not outlive the next read. */
+static void read_blocks(const std::string &filepath,
+                        const table_header_t &header,
+                        data_frame_t &data_frame, DataTableInput &input) {
+    std::size_t row_index = 0;
+    while (row_index < data_frame.row_count) {
+        std::size_t block_row_count = parse_value<std::uint32_t>(input);
+
+        if (row_index + block_row_count > header.row_count) {
+            raise_format_error("%s has more rows than the %lu in its header",
+                               filepath.c_str(), header.row_count);
+        }
+
+        std::size_t block_read_count =
+            std::min(block_row_count, data_frame.row_count - row_index);
+
+        for (std::size_t column_index = 0;
+             column_index < header.column_names.size(); ++column_index) {
+            std::size_t chunk_size =
+                parse_value<BinaryDataTableStream::block_size_t>(input);
+            int slot = data_frame.column_slots[column_index];
+            const DataTableStream::column_type_t &column_type =
+                header.column_types[column_index];
+            if (slot == -1) {
+                input.skip(chunk_size);
+            } else if (column_type.first == STRSXP) {
+                read_string_chunk(filepath, column_index, data_frame, slot,
+                                  input.read(chunk_size), chunk_size,
+                                  row_index, block_row_count,
+                                  block_read_count);
+            } else {
+                check_column_chunk(filepath, column_index, column_type,
+                                   chunk_size, block_row_count);
+                copy_column_chunk(column_type, input.read(chunk_size),
+                                  get_column_values(data_frame.columns[slot]),
+                                  row_index, block_read_count);
+            }
+        }
+
+        row_index += block_read_count;
+    }
+}
+
+/* turns the integer codes of string columns into factors with the column
+   dictionaries as levels */
+static void create_factors(data_frame_t &data_frame) {
+    for (std::size_t slot = 0; slot < data_frame.columns.size(); ++slot) {
+        const string_dictionary_t &dictionary =
+            data_frame.string_dictionaries[slot];
+        if (dictionary.entries == R_NilValue) {
+            continue;
+        }
+        SEXP levels = PROTECT(allocVector(STRSXP, dictionary.size));
+        for (int index = 0; index < dictionary.size; ++index) {
+            SET_STRING_ELT(levels, index,
+                           STRING_ELT(dictionary.entries, index));
+        }
+        setAttrib(data_frame.columns[slot], R_LevelsSymbol, levels);
+        setAttrib(data_frame.columns[slot], R_ClassSymbol, mkString("factor"));
+        UNPROTECT(1);
+    }
+}
+
+/* reads the selected columns of the first row_count rows of the table, or
+   all rows if row_count is negative. Uncompressed tables are read with
+   thread_count_hint threads, or one per core if it is not positive. */
+static SEXP read_binary_data_table(const std::string &filepath,
+                                   int compression_level,
+                                   SEXP selected_columns, int row_count,
+                                   bool strings_as_factors,
+                                   int thread_count_hint) {
+    const MemoryMapping mapping{filepath};
+    const char *buffer = mapping.data();
+    const char *const end_of_buffer = buffer + mapping.size();
+    const char *end = nullptr;
+    table_header_t header{
+        read_header(filepath, buffer, end_of_buffer, &end)};
+    data_frame_t data_frame{create_data_frame(
+        filepath, header, selected_columns,
+        row_count < 0 ? header.row_count
+                      : std::min<std::size_t>(row_count, header.row_count),
+        strings_as_factors)};
+    /* only the blocks following the header are compressed */
+    DataTableInput input{filepath, end,
+                         static_cast<std::size_t>(end_of_buffer - end),
+                         compression_level != 0};
+
+    std::size_t thread_count = thread_count_hint > 0
+                                   ? thread_count_hint
+                                   : std::thread::hardware_concurrency();
+
+    if (compression_level != 0 || thread_count <= 1) {
+        read_blocks(filepath, header, data_frame, input);
+    } else {
+        std::vector<block_t> blocks{
+            index_blocks(filepath, header, data_frame, input)};
+        read_blocks_in_parallel(filepath, header, data_frame, blocks,
+                                std::min(thread_count, blocks.size()));
+    }
+
+    if (strings_as_factors) {
+        create_factors(data_frame);
+    }
+
+    UNPROTECT(2);
     return data_frame.object;
 }
 
-SEXP read_data_table(SEXP table_filepath, SEXP binary, SEXP compression_level) {
-    const std::string filepath_unwrapped = sexp_to_string(table_filepath);
-    bool binary_unwrapped = sexp_to_bool(binary);
-    int compression_level_unwrapped = sexp_to_int(compression_level);
-    return (binary_unwrapped
-                ? read_binary_data_table(filepath_unwrapped,
-                                         compression_level_unwrapped)
-                : read_text_data_table(filepath_unwrapped,
-                                       compression_level_unwrapped));
+SEXP read_data_table(SEXP table_filepath, SEXP binary, SEXP compression_level,
+                     SEXP columns, SEXP n_max, SEXP strings_as_factors,
+                     SEXP threads) {
+    char message[1024] = "";
+
+    SEXP data_frame = catch_format_error(
+        [&] {
+            const std::string filepath_unwrapped =
+                sexp_to_string(table_filepath);
+            bool binary_unwrapped = sexp_to_bool(binary);
+            int compression_level_unwrapped = sexp_to_int(compression_level);
+            return (binary_unwrapped
+                        ? read_binary_data_table(
+                              filepath_unwrapped, compression_level_unwrapped,
+                              columns, sexp_to_int(n_max),
+                              sexp_to_bool(strings_as_factors),
+                              sexp_to_int(threads))
+                        : read_text_data_table(filepath_unwrapped,
+                                               compression_level_unwrapped));
+        },
+        message, sizeof(message));
+
+    /* raised only once the mapping and the readers are released */
+    if (message[0] != '\0') {
+        Rf_error("%s", message);
+    }
+
+    return data_frame;
 }
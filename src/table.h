@@ -9,16 +9,20 @@
 DataTableStream *create_data_table(const std::string &table_filepath,
                                    const std::vector<std::string> &column_names,
                                    bool truncate, bool binary = true,
-                                   int compression_level = 0);
+                                   int compression_level = 0,
+                                   int compression_threads = 0);
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 SEXP write_data_table(SEXP data_frame, SEXP table_filepath, SEXP truncate,
-                      SEXP binary, SEXP compression_level);
+                      SEXP binary, SEXP compression_level,
+                      SEXP compression_threads);
 
-SEXP read_data_table(SEXP table_filepath, SEXP binary, SEXP compression_level);
+SEXP read_data_table(SEXP table_filepath, SEXP binary, SEXP compression_level,
+                     SEXP columns, SEXP n_max, SEXP strings_as_factors,
+                     SEXP threads);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,185 @@
+#include "trace.h"
+#include "TraceSerializer.h"
+#include "ZstdDecompressionStream.h"
+
+/* Presents a binary trace, compressed or not, as a sequence of bytes. */
+class TraceReader {
+  public:
+    TraceReader(const std::string &filepath)
+        : filepath_{filepath}, mapping_{filepath}, current_{nullptr},
+          end_{nullptr}, decompression_stream_{nullptr}, buffer_{nullptr},
+          buffer_size_{0} {
+
+        const char *data = mapping_.data();
+        const std::size_t size = mapping_.size();
+
+        if (ZstdDecompressionStream::is_compressed(data, size)) {
+            decompression_stream_ = new ZstdDecompressionStream(data, size);
+            buffer_size_ = ZSTD_DStreamOutSize();
+            buffer_ = static_cast<char *>(malloc_or_die(buffer_size_));
+            current_ = end_ = buffer_;
+        } else {
+            current_ = data;
+            end_ = current_ + size;
+        }
+    }
+
+    bool at_end() { return current_ == end_ && !refill_(); }
+
+    std::uint8_t read_byte() {
+        if (at_end()) {
+            raise_format_error("unexpected end of trace %s",
+                               filepath_.c_str());
+        }
+        return static_cast<std::uint8_t>(*current_++);
+    }
+
+    std::uint64_t read_varint() {
+        std::uint64_t value = 0;
+        std::uint8_t byte = 0;
+        int shift = 0;
+        do {
+            byte = read_byte();
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    void read_bytes(std::string &destination, std::size_t bytes) {
+        while (bytes != 0) {
+            if (at_end()) {
+                raise_format_error("unexpected end of trace %s",
+                               filepath_.c_str());
+            }
+            std::size_t copied_bytes =
+                std::min(static_cast<std::size_t>(end_ - current_), bytes);
+            destination.append(current_, copied_bytes);
+            current_ += copied_bytes;
+            bytes -= copied_bytes;
+        }
+    }
+
+    ~TraceReader() {
+        delete decompression_stream_;
+        std::free(buffer_);
+    }
+
+  private:
+    bool refill_() {
+        if (decompression_stream_ == nullptr) {
+            return false;
+        }
+        std::size_t bytes = decompression_stream_->read(buffer_, buffer_size_);
+        current_ = buffer_;
+        end_ = buffer_ + bytes;
+        return bytes != 0;
+    }
+
+    std::string filepath_;
+    /* unmapped even when the constructor throws */
+    MemoryMapping mapping_;
+    const char *current_;
+    const char *end_;
+    ZstdDecompressionStream *decompression_stream_;
+    char *buffer_;
+    std::size_t buffer_size_;
+};
+
+static void decode_field(TraceReader &reader, std::vector<std::string> &strings,
+                         std::string &record) {
+    std::uint64_t value = reader.read_varint();
+
+    if ((value & 1) == TraceSerializer::FIELD_INTEGER) {
+        std::uint64_t zigzag = value >> 1;
+        std::int64_t integer = static_cast<std::int64_t>(zigzag >> 1) ^
+                               -static_cast<std::int64_t>(zigzag & 1);
+        record.append(std::to_string(integer));
+        return;
+    }
+
+    value = value >> 1;
+    std::uint64_t kind = value & 3;
+    std::uint64_t payload = value >> 2;
+
+    if (kind == TraceSerializer::STRING_REFERENCE) {
+        if (payload >= strings.size()) {
+            raise_format_error("reference to undefined string %lu in trace",
+                               payload);
+        }
+        record.append(strings[payload]);
+    } else if (kind == TraceSerializer::STRING_DEFINITION) {
+        strings.emplace_back();
+        reader.read_bytes(strings.back(), payload);
+        record.append(strings.back());
+    } else {
+        reader.read_bytes(record, payload);
+    }
+}
+
+static void decode_trace_(const std::string &binary_filepath,
+                          const std::string &text_filepath) {
+    TraceReader reader{binary_filepath};
+
+    std::string magic;
+    reader.read_bytes(magic, TraceSerializer::BINARY_TRACE_MAGIC.size());
+    if (magic != TraceSerializer::BINARY_TRACE_MAGIC) {
+        raise_format_error("%s is not a binary trace", binary_filepath.c_str());
+    }
+    std::uint8_t version = reader.read_byte();
+    if (version != TraceSerializer::BINARY_TRACE_VERSION) {
+        raise_format_error("%s is a binary trace of version %d, expected %d",
+                           binary_filepath.c_str(), version,
+                           TraceSerializer::BINARY_TRACE_VERSION);
+    }
+
+    FileStream file_stream{text_filepath, O_WRONLY | O_CREAT | O_TRUNC};
+    BufferStream buffer_stream{&file_stream};
+    std::vector<std::string> strings;
+    std::string record;
+
+    while (!reader.at_end()) {
+        TraceSerializer::opcode_t opcode = reader.read_byte();
+        std::uint8_t field_count = reader.read_byte();
+
+        if (opcode == TraceSerializer::OPCODE_STRINGS_RESET) {
+            strings.clear();
+            continue;
+        }
+
+        if (opcode >= TraceSerializer::OPCODE_COUNT) {
+            raise_format_error("invalid opcode %d in trace %s", opcode,
+                               binary_filepath.c_str());
+        }
+
+        record.clear();
+        record.append(TraceSerializer::opcode_to_string(opcode));
+
+        for (int field = 0; field < field_count; ++field) {
+            record.push_back(UNIT_SEPARATOR);
+            decode_field(reader, strings, record);
+        }
+
+        record.push_back(RECORD_SEPARATOR);
+        record.push_back('\n');
+        buffer_stream.write(record.data(), record.size());
+    }
+}
+
+SEXP decode_trace(SEXP binary_trace_filepath, SEXP text_trace_filepath) {
+    char message[1024] = "";
+
+    catch_format_error(
+        [&] {
+            decode_trace_(sexp_to_string(binary_trace_filepath),
+                          sexp_to_string(text_trace_filepath));
+            return R_NilValue;
+        },
+        message, sizeof(message));
+
+    if (message[0] != '\0') {
+        Rf_error("%s", message);
+    }
+
+    return R_NilValue;
+}
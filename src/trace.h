@@ -0,0 +1,16 @@
+#ifndef PROMISEDYNTRACER_TRACE_H
+#define PROMISEDYNTRACER_TRACE_H
+
+#include <Rinternals.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SEXP decode_trace(SEXP binary_trace_filepath, SEXP text_trace_filepath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROMISEDYNTRACER_TRACE_H */
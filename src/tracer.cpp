@@ -1,6 +1,27 @@
 #include "tracer.h"
 #include "probes.h"
 
+#ifdef DYNTRACE_COUNT_EVENTS
+
+/* Attaches PROBE behind a counter of the probe events, which the benchmarks
+   divide by the run time. */
+template <auto PROBE> struct counted;
+
+template <typename... Args, void (*PROBE)(dyntracer_t *, Args...)>
+struct counted<PROBE> {
+    static void probe(dyntracer_t *dyntracer, Args... args) {
+        ++tracer_state(dyntracer).event_counter;
+        PROBE(dyntracer, args...);
+    }
+};
+
+#else
+
+/* attaches PROBE itself */
+template <auto PROBE> struct counted { static constexpr auto probe = PROBE; };
+
+#endif /* DYNTRACE_COUNT_EVENTS */
+
 extern "C" {
 
 // verbose:
@@ -10,44 +31,75 @@ extern "C" {
 //     -1: SQL queries,
 SEXP create_dyntracer(SEXP trace_filepath, SEXP truncate, SEXP enable_trace,
                       SEXP verbose, SEXP output_dir, SEXP binary,
-                      SEXP compression_level, SEXP analysis_switch) {
-    void *context = new Context(
+                      SEXP compression_level, SEXP compression_threads,
+                      SEXP analysis_switch, SEXP sampling_switch,
+                      SEXP binary_trace, SEXP trace_compression_level) {
+    /* parsed first as invalid settings raise an R error */
+    SamplingSwitch sampling = to_sampling_switch(sampling_switch);
+
+    Context *context = new Context(
         sexp_to_string(trace_filepath), sexp_to_bool(truncate),
         sexp_to_bool(enable_trace), sexp_to_bool(verbose),
         sexp_to_string(output_dir), sexp_to_bool(binary),
-        sexp_to_int(compression_level), to_analysis_switch(analysis_switch));
+        sexp_to_int(compression_level), sexp_to_int(compression_threads),
+        to_analysis_switch(analysis_switch), sampling,
+        sexp_to_bool(binary_trace), sexp_to_int(trace_compression_level));
 
     /* calloc initializes the memory to zero. This ensures that probes not
        attached will be NULL. Replacing calloc with malloc will cause
        segfaults. */
     dyntracer_t *dyntracer = (dyntracer_t *)calloc(1, sizeof(dyntracer_t));
-    dyntracer->probe_dyntrace_entry = dyntrace_entry;
-    dyntracer->probe_dyntrace_exit = dyntrace_exit;
-    dyntracer->probe_closure_entry = closure_entry;
-    dyntracer->probe_closure_exit = closure_exit;
-    dyntracer->probe_builtin_entry = builtin_entry;
-    dyntracer->probe_builtin_exit = builtin_exit;
-    dyntracer->probe_special_entry = special_entry;
-    dyntracer->probe_special_exit = special_exit;
-    dyntracer->probe_gc_unmark = gc_unmark;
-    dyntracer->probe_promise_force_entry = promise_force_entry;
-    dyntracer->probe_promise_force_exit = promise_force_exit;
-    dyntracer->probe_gc_allocate = gc_allocate;
-    dyntracer->probe_promise_value_lookup = promise_value_lookup;
-    dyntracer->probe_promise_expression_lookup = promise_expression_lookup;
-    dyntracer->probe_promise_environment_lookup = promise_environment_lookup;
-    dyntracer->probe_promise_value_assign = promise_value_assign;
-    dyntracer->probe_promise_expression_assign = promise_expression_assign;
-    dyntracer->probe_promise_environment_assign = promise_environment_assign;
-    dyntracer->probe_gc_entry = gc_entry;
-    dyntracer->probe_gc_exit = gc_exit;
-    dyntracer->probe_context_entry = context_entry;
-    dyntracer->probe_context_jump = context_jump;
-    dyntracer->probe_context_exit = context_exit;
-    dyntracer->probe_environment_variable_define = environment_variable_define;
-    dyntracer->probe_environment_variable_assign = environment_variable_assign;
-    dyntracer->probe_environment_variable_remove = environment_variable_remove;
-    dyntracer->probe_environment_variable_lookup = environment_variable_lookup;
+    dyntracer->probe_dyntrace_entry = counted<dyntrace_entry>::probe;
+    dyntracer->probe_dyntrace_exit = counted<dyntrace_exit>::probe;
+    dyntracer->probe_closure_entry = counted<closure_entry>::probe;
+    dyntracer->probe_closure_exit = counted<closure_exit>::probe;
+    dyntracer->probe_builtin_entry = counted<builtin_entry>::probe;
+    dyntracer->probe_builtin_exit = counted<builtin_exit>::probe;
+    dyntracer->probe_special_entry = counted<special_entry>::probe;
+    dyntracer->probe_special_exit = counted<special_exit>::probe;
+    dyntracer->probe_gc_unmark = counted<gc_unmark>::probe;
+    dyntracer->probe_promise_force_entry = counted<promise_force_entry>::probe;
+    dyntracer->probe_promise_force_exit = counted<promise_force_exit>::probe;
+    dyntracer->probe_gc_allocate = counted<gc_allocate>::probe;
+    dyntracer->probe_context_entry = counted<context_entry>::probe;
+    dyntracer->probe_context_jump = counted<context_jump>::probe;
+    dyntracer->probe_context_exit = counted<context_exit>::probe;
+
+    /* the remaining probes only feed the trace, the debug serializer and
+       some analyses. They are left NULL unless one of them is enabled. */
+    const probe_groups_t probe_groups = context->get_probe_groups();
+
+    if (probe_groups & PROBES_PROMISE_SLOT) {
+        dyntracer->probe_promise_value_lookup =
+            counted<promise_value_lookup>::probe;
+        dyntracer->probe_promise_expression_lookup =
+            counted<promise_expression_lookup>::probe;
+        dyntracer->probe_promise_environment_lookup =
+            counted<promise_environment_lookup>::probe;
+        dyntracer->probe_promise_value_assign =
+            counted<promise_value_assign>::probe;
+        dyntracer->probe_promise_expression_assign =
+            counted<promise_expression_assign>::probe;
+        dyntracer->probe_promise_environment_assign =
+            counted<promise_environment_assign>::probe;
+    }
+
+    if (probe_groups & PROBES_GC) {
+        dyntracer->probe_gc_entry = counted<gc_entry>::probe;
+        dyntracer->probe_gc_exit = counted<gc_exit>::probe;
+    }
+
+    if (probe_groups & PROBES_ENVIRONMENT_VARIABLE) {
+        dyntracer->probe_environment_variable_define =
+            counted<environment_variable_define>::probe;
+        dyntracer->probe_environment_variable_assign =
+            counted<environment_variable_assign>::probe;
+        dyntracer->probe_environment_variable_remove =
+            counted<environment_variable_remove>::probe;
+        dyntracer->probe_environment_variable_lookup =
+            counted<environment_variable_lookup>::probe;
+    }
+
     dyntracer->state = context;
     return dyntracer_to_sexp(dyntracer, "dyntracer.promise");
 }
@@ -11,7 +11,9 @@ extern "C" {
 
 SEXP create_dyntracer(SEXP trace_filepath, SEXP truncate, SEXP enable_trace,
                       SEXP verbose, SEXP output_dir, SEXP binary,
-                      SEXP compression_level, SEXP analysis_switch_env);
+                      SEXP compression_level, SEXP compression_threads,
+                      SEXP analysis_switch_env, SEXP sampling_switch_env,
+                      SEXP binary_trace, SEXP trace_compression_level);
 
 SEXP destroy_dyntracer(SEXP tracer);
 
@@ -1,7 +1,12 @@
 #include "utilities.h"
-#include "base64.h"
 #include "lookup.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
+#include "base64.h"
+#endif
 
 size_t SQLITE3_ERROR_MESSAGE_BUFFER_SIZE = 1000;
 size_t SQLITE3_EXPANDED_SQL_BUFFER_SIZE = 2000;
@@ -11,6 +16,15 @@ size_t SQLITE3_EXPANDED_SQL_BUFFER_SIZE = 2000;
 const char RECORD_SEPARATOR = 0x1e;
 const char UNIT_SEPARATOR = 0x1f;
 
+void raise_format_error(const char *format, ...) {
+    char message[1024];
+    va_list arguments;
+    va_start(arguments, format);
+    std::vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+    throw format_error(message);
+}
+
 int get_file_size(std::ifstream &file) {
     int position = file.tellg();
     file.seekg(0, std::ios_base::end);
@@ -239,7 +253,99 @@ const char *get_ns_name(SEXP op) {
     return NULL;
 }
 
-std::string compute_hash(const char *data) {
+/* XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ */
+static const std::uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const std::uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const std::uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const std::uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const std::uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline std::uint64_t xxh_rotl64(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline std::uint64_t xxh_read64(const unsigned char *data) {
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline std::uint32_t xxh_read32(const unsigned char *data) {
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline std::uint64_t xxh_round(std::uint64_t accumulator,
+                                      std::uint64_t input) {
+    accumulator += input * XXH_PRIME64_2;
+    return xxh_rotl64(accumulator, 31) * XXH_PRIME64_1;
+}
+
+static inline std::uint64_t xxh_merge_round(std::uint64_t accumulator,
+                                            std::uint64_t value) {
+    accumulator ^= xxh_round(0, value);
+    return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+std::uint64_t compute_hash(const void *data, std::size_t size,
+                           std::uint64_t seed) {
+    const unsigned char *current = static_cast<const unsigned char *>(data);
+    const unsigned char *const end = current + size;
+    std::uint64_t hash;
+
+    if (size >= 32) {
+        std::uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        std::uint64_t v2 = seed + XXH_PRIME64_2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - XXH_PRIME64_1;
+        const unsigned char *const limit = end - 32;
+        do {
+            v1 = xxh_round(v1, xxh_read64(current));
+            v2 = xxh_round(v2, xxh_read64(current + 8));
+            v3 = xxh_round(v3, xxh_read64(current + 16));
+            v4 = xxh_round(v4, xxh_read64(current + 24));
+            current += 32;
+        } while (current <= limit);
+        hash = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) +
+               xxh_rotl64(v4, 18);
+        hash = xxh_merge_round(hash, v1);
+        hash = xxh_merge_round(hash, v2);
+        hash = xxh_merge_round(hash, v3);
+        hash = xxh_merge_round(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    hash += size;
+
+    for (; current + 8 <= end; current += 8) {
+        hash ^= xxh_round(0, xxh_read64(current));
+        hash = xxh_rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    if (current + 4 <= end) {
+        hash ^= xxh_read32(current) * XXH_PRIME64_1;
+        hash = xxh_rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        current += 4;
+    }
+
+    for (; current < end; ++current) {
+        hash ^= *current * XXH_PRIME64_5;
+        hash = xxh_rotl64(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
+std::string compute_legacy_hash(const char *data) {
     const EVP_MD *md = EVP_md5();
     unsigned char md_value[EVP_MAX_MD_SIZE];
     unsigned int md_len = 0;
@@ -268,6 +374,7 @@ std::string compute_hash(const char *data) {
     std::replace(result.begin(), result.end(), '/', '#');
     return result;
 }
+#endif
 
 const char *remove_null(const char *value) { return value ? value : ""; }
 
@@ -298,6 +405,63 @@ AnalysisSwitch to_analysis_switch(SEXP env) {
     return analysis_switch;
 }
 
+SamplingSwitch to_sampling_switch(SEXP env) {
+
+    auto get_value = [&](const std::string &name) {
+        return Rf_findVar(Rf_install(("sampling_" + name).c_str()), env);
+    };
+
+    SamplingSwitch sampling_switch{SamplingSwitch::Mode::NONE, 1, 0, 0};
+
+    SEXP mode = get_value("mode");
+    if (mode != R_UnboundValue) {
+        const std::string mode_name = sexp_to_string(mode);
+        if (mode_name == "none")
+            sampling_switch.mode = SamplingSwitch::Mode::NONE;
+        else if (mode_name == "call")
+            sampling_switch.mode = SamplingSwitch::Mode::CALL;
+        else if (mode_name == "function")
+            sampling_switch.mode = SamplingSwitch::Mode::FUNCTION;
+        else if (mode_name == "time")
+            sampling_switch.mode = SamplingSwitch::Mode::TIME;
+        else
+            Rf_error("unknown sampling mode '%s'", mode_name.c_str());
+    }
+
+    SEXP period = get_value("period");
+    if (period != R_UnboundValue)
+        sampling_switch.period = Rf_asReal(period);
+
+    SEXP window = get_value("window");
+    if (window != R_UnboundValue)
+        sampling_switch.window = Rf_asReal(window);
+
+    SEXP seed = get_value("seed");
+    if (seed != R_UnboundValue)
+        sampling_switch.seed = static_cast<std::uint64_t>(Rf_asReal(seed));
+
+    if (sampling_switch.mode == SamplingSwitch::Mode::CALL ||
+        sampling_switch.mode == SamplingSwitch::Mode::FUNCTION) {
+        if (!(sampling_switch.period >= 1))
+            Rf_error("sampling period has to be at least 1");
+        /* the sampler counts in whole periods */
+        if (sampling_switch.period != std::floor(sampling_switch.period))
+            Rf_error("sampling period has to be an integer in %s mode",
+                     sampling_mode_to_string(sampling_switch.mode).c_str());
+    }
+
+    if (!(sampling_switch.period > 0))
+        Rf_error("sampling period has to be positive");
+
+    if (sampling_switch.mode == SamplingSwitch::Mode::TIME &&
+        !(sampling_switch.window > 0 &&
+          sampling_switch.window <= sampling_switch.period))
+        Rf_error("sampling window has to be positive and at most the "
+                 "sampling period in time mode");
+
+    return sampling_switch;
+}
+
 std::string to_string(const char *str) {
     return str ? std::string(str) : std::string("");
 }
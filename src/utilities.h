@@ -2,8 +2,14 @@
 #define __UTILITIES_H__
 
 #include "AnalysisSwitch.h"
+#include "SamplingSwitch.h"
 #include "stdlibs.h"
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
 #include <openssl/evp.h>
+#endif
 
 extern const char UNIT_SEPARATOR;
 extern const char RECORD_SEPARATOR;
@@ -17,6 +23,29 @@ extern const char RECORD_SEPARATOR;
         exit(EXIT_FAILURE);                                                    \
     } while (0)
 
+/* Thrown by the readers of traces and data tables on malformed input.
+   Rf_error longjmps past C++ destructors, so the R entry points of the
+   readers catch it and only call Rf_error once the reader is destroyed. */
+class format_error : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void raise_format_error(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+/* Runs read and returns its result. On a format_error, the message is
+   copied to message and R_NilValue is returned once read has unwound. */
+template <typename F>
+SEXP catch_format_error(F read, char *message, std::size_t size) {
+    try {
+        return read();
+    } catch (const format_error &error) {
+        std::snprintf(message, size, "%s", error.what());
+        return R_NilValue;
+    }
+}
+
 int get_file_size(std::ifstream &file);
 
 std::string readfile(std::ifstream &file);
@@ -36,7 +65,11 @@ typename std::underlying_type<T>::type to_underlying_type(const T &enum_val) {
     return static_cast<typename std::underlying_type<T>::type>(enum_val);
 }
 
-std::string compute_hash(const char *data);
+std::uint64_t compute_hash(const void *data, std::size_t size,
+                           std::uint64_t seed = 0);
+#ifdef DYNTRACE_LEGACY_FUNCTION_IDS
+std::string compute_legacy_hash(const char *data);
+#endif
 const char *get_ns_name(SEXP op);
 const char *get_name(SEXP call);
 std::string get_definition_location_cpp(SEXP op);
@@ -48,6 +81,7 @@ std::string escape(const std::string &s);
 const char *remove_null(const char *value);
 std::string clock_ticks_to_string(clock_t ticks);
 AnalysisSwitch to_analysis_switch(SEXP env);
+SamplingSwitch to_sampling_switch(SEXP env);
 std::string to_string(const char *str);
 
 inline std::string check_string(const char *s) {